@@ -8,6 +8,8 @@
 #include <jaffarCommon/serializers/contiguous.hpp>
 #include <jaffarCommon/deserializers/contiguous.hpp>
 #include "inputParser.hpp"
+#include "affinity.hpp"
+#include <cstring>
 
 namespace rawspace
 {
@@ -47,12 +49,45 @@ class EmuInstanceBase
   virtual int16_t* getScriptStackData() const = 0;
   virtual size_t getScriptStackDataSize() const = 0;
 
-  void initialize(const std::string& gameDataPath)
+  // The optional cpu / NUMA node hints pin the calling (owning) thread before anything gets allocated,
+  // so that the emulator memory is placed on that node by first touch
+  void initialize(const std::string& gameDataPath, const int cpuHint = -1, const int numaNodeHint = -1)
   {
+    if (cpuHint >= 0) if (affinity::pinThreadToCpu(cpuHint) == false) JAFFAR_THROW_RUNTIME("Could not pin thread to cpu %d\n", cpuHint);
+    if (numaNodeHint >= 0) if (affinity::pinThreadToNumaNode(numaNodeHint) == false) JAFFAR_THROW_RUNTIME("Could not pin thread to NUMA node %d\n", numaNodeHint);
+
     initializeImpl(gameDataPath);
     _stateSize = getStateSizeImpl();
   }
 
+  // Gets the NUMA node where the emulator memory resides (-1 if unknown), judged by its largest allocation
+  inline int getMemoryNumaNode() const { return affinity::getMemoryNumaNode(getLargestAllocationPtr()); }
+
+  // Start of the largest block of emulator memory. Defaults to the VM variables for cores that do not tell
+  virtual const uint8_t* getLargestAllocationPtr() const { return getRamPointer(); }
+
+  // Resource I/O counters as (name, value) pairs. Empty if the core does not keep them
+  virtual std::vector<std::pair<std::string, uint64_t>> getResourceCounters() const { return {}; }
+  virtual void resetResourceCounters() {}
+
+  // Headless observations of the displayed frame (OBSERVATION_WIDTH x OBSERVATION_HEIGHT pixels), without SDL.
+  // Indexed: one palette index (0-15) per pixel. RGBA: bytes R, G, B, A in memory for each pixel.
+  // The defaults convert the video output pixels and palette, cores may read their frame buffer directly
+  static constexpr size_t OBSERVATION_WIDTH = 320;
+  static constexpr size_t OBSERVATION_HEIGHT = 200;
+
+  virtual void getObservationIndexed(uint8_t *indices) const
+  {
+    memcpy(indices, getPixelsPtr(), OBSERVATION_WIDTH * OBSERVATION_HEIGHT);
+  }
+
+  virtual void getObservation(uint32_t *rgba) const
+  {
+    const auto pixels = getPixelsPtr();
+    const auto palette = (const uint32_t *)getPalettePtr();
+    for (size_t i = 0; i < OBSERVATION_WIDTH * OBSERVATION_HEIGHT; i++) rgba[i] = palette[pixels[i] & 0xF];
+  }
+
   virtual uint8_t* getPixelsPtr() const = 0;
   virtual size_t getPixelsSize() const = 0;
   virtual uint8_t* getPalettePtr() const = 0;
@@ -63,6 +98,19 @@ class EmuInstanceBase
   virtual void enableRendering() = 0;
   virtual void disableRendering() = 0;
 
+  // Whether draw calls are still recorded while rendering is disabled ('Deferred Rendering'), so that
+  // saved states and observations are exact without rendering every frame
+  virtual bool isDeferredRenderingEnabled() const { return false; }
+
+  // Whether the core runs without a window or audio device (NullSystem), so instances can run on several threads
+  virtual bool isHeadless() const { return false; }
+
+  // Offline audio ('Offline Audio'): every advanced frame mixes the audio it lasts, without any audio
+  // device or thread. Samples are mono, unsigned 8 bits, and stay valid until the next frame
+  virtual bool isOfflineAudioEnabled() const { return false; }
+  virtual size_t getAudioSampleRate() const { return 0; }
+  virtual const uint8_t* getFrameAudio(size_t &sampleCount) const { sampleCount = 0; return nullptr; }
+
   void enableStateBlock(const std::string& block) 
   {
     enableStateBlockImpl(block);
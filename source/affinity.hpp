@@ -0,0 +1,122 @@
+#pragma once
+
+// Thread placement helpers (CPU / NUMA node pinning)
+// Linux only: on other platforms pinning is a no-op and queries return -1
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+  #include <sched.h>
+  #include <unistd.h>
+  #include <sys/syscall.h>
+#endif
+
+namespace rawspace
+{
+
+namespace affinity
+{
+
+// Parses a sysfs cpu list (e.g. "0-7,16-23") into its cpu ids
+inline std::vector<int> parseCpuList(const std::string &cpuList)
+{
+  std::vector<int> cpus;
+
+  size_t pos = 0;
+  while (pos < cpuList.size())
+  {
+    size_t end = cpuList.find(',', pos);
+    if (end == std::string::npos) end = cpuList.size();
+
+    const auto range = cpuList.substr(pos, end - pos);
+    int first, last;
+    if (sscanf(range.c_str(), "%d-%d", &first, &last) == 2) for (int i = first; i <= last; i++) cpus.push_back(i);
+    else if (sscanf(range.c_str(), "%d", &first) == 1) cpus.push_back(first);
+
+    pos = end + 1;
+  }
+
+  return cpus;
+}
+
+// Gets the cpus belonging to a given NUMA node (empty if the node does not exist)
+inline std::vector<int> getNumaNodeCpus(const int node)
+{
+  char path[256];
+  sprintf(path, "/sys/devices/system/node/node%d/cpulist", node);
+
+  FILE *f = fopen(path, "r");
+  if (f == nullptr) return {};
+
+  char buffer[4096] = {0};
+  const auto readBytes = fread(buffer, 1, sizeof(buffer) - 1, f);
+  fclose(f);
+  buffer[readBytes] = '\0';
+
+  return parseCpuList(std::string(buffer));
+}
+
+// Pins the calling thread to the given set of cpus
+inline bool pinThreadToCpus(const std::vector<int> &cpus)
+{
+#ifdef __linux__
+  if (cpus.empty()) return false;
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  for (const auto cpu : cpus) CPU_SET(cpu, &mask);
+  return sched_setaffinity(0, sizeof(mask), &mask) == 0;
+#else
+  return false;
+#endif
+}
+
+// Pins the calling thread to a single cpu
+inline bool pinThreadToCpu(const int cpu) { return pinThreadToCpus({cpu}); }
+
+// Pins the calling thread to all the cpus of a NUMA node
+inline bool pinThreadToNumaNode(const int node) { return pinThreadToCpus(getNumaNodeCpus(node)); }
+
+// Gets the cpu the calling thread is currently running on
+inline int getCurrentCpu()
+{
+#ifdef __linux__
+  return sched_getcpu();
+#else
+  return -1;
+#endif
+}
+
+// Gets the NUMA node a cpu belongs to
+inline int getCpuNumaNode(const int cpu)
+{
+  if (cpu < 0) return -1;
+  for (int node = 0;; node++)
+  {
+    const auto cpus = getNumaNodeCpus(node);
+    if (cpus.empty()) return node == 0 ? 0 : -1; // Non-NUMA systems report everything on node 0
+    for (const auto c : cpus) if (c == cpu) return node;
+  }
+}
+
+// Gets the NUMA node the calling thread is currently running on
+inline int getCurrentNumaNode() { return getCpuNumaNode(getCurrentCpu()); }
+
+// Gets the NUMA node where the page holding the given address resides
+inline int getMemoryNumaNode(const void *ptr)
+{
+#if defined(__linux__) && defined(SYS_get_mempolicy)
+  // MPOL_F_NODE | MPOL_F_ADDR: return the node of the page containing 'ptr'
+  const unsigned long flags = 1 | 2;
+  int node = -1;
+  if (syscall(SYS_get_mempolicy, &node, nullptr, 0, ptr, flags) != 0) return -1;
+  return node;
+#else
+  return -1;
+#endif
+}
+
+} // namespace affinity
+
+} // namespace rawspace
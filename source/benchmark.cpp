@@ -0,0 +1,299 @@
+#include "argparse/argparse.hpp"
+#include <jaffarCommon/json.hpp>
+#include <jaffarCommon/serializers/contiguous.hpp>
+#include <jaffarCommon/deserializers/contiguous.hpp>
+#include <jaffarCommon/string.hpp>
+#include <jaffarCommon/file.hpp>
+#include "NEORAWInstance.hpp"
+#include <resource.h>
+#include <bank.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <vector>
+#include <string>
+
+// Microbenchmark suite, built for both cores. Every benchmark runs in isolation and reports the time
+// per operation, so that the two builds can be compared entry by entry (see --compare):
+//  - interpreter.partXXXX: one input (VM frame) with rendering disabled, per game part
+//  - rendering.partXXXX:   the extra time the same input takes with rendering enabled, per game part
+//  - state.save.full/vm:   serializing the state with / without the non-VM state (NVS) block
+//  - state.load.full/vm:   deserializing it
+//  - state.hash:           hashing the VM state (getStateHash)
+//  - unpack.bankXX:        unpacking every packed entry of a bank
+//  - display.update:       showing the current page (Video::updateDisplay)
+//
+// The per-part timings are taken input by input, while replaying the sequence from its initial state.
+// The rasterizer entry points differ between the cores, so drawing is measured on these recorded frames.
+
+struct benchmarkResult_t
+{
+  std::string name;
+  uint64_t ops;
+  double ns;
+};
+
+static double getNanoseconds(const std::chrono::high_resolution_clock::time_point &t0, const std::chrono::high_resolution_clock::time_point &tf)
+{
+  return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(tf - t0).count();
+}
+
+// Keeps the compiler from dropping or hoisting the computation of 'value' out of a benchmark loop
+template <typename T>
+static inline void doNotOptimize(const T &value) { asm volatile("" : : "r"(&value) : "memory"); }
+
+// Runs 'op' 'ops' times
+template <typename F>
+static benchmarkResult_t measure(const std::string &name, const uint64_t ops, F op)
+{
+  auto t0 = std::chrono::high_resolution_clock::now();
+  for (uint64_t i = 0; i < ops; i++) op();
+  auto tf = std::chrono::high_resolution_clock::now();
+  return { name, ops, getNanoseconds(t0, tf) };
+}
+
+static std::string getPartName(const uint16_t partId)
+{
+  char name[16];
+  sprintf(name, "part%04X", partId);
+  return name;
+}
+
+// Replays the sequence 'replays' times from the initial state, accumulating the time of every input
+// on the game part it ran in
+static void replaySequence(rawspace::EmuInstance &e, const std::vector<jaffar::input_t> &sequence, uint8_t *initialState, const size_t stateSize, const int replays, std::map<uint16_t, benchmarkResult_t> &parts)
+{
+  for (int r = 0; r < replays; r++)
+  {
+    jaffarCommon::deserializer::Contiguous d(initialState, stateSize);
+    e.deserializeState(d);
+    for (const auto &input : sequence)
+    {
+      const uint16_t partId = ::e->res.currentPartId;
+      auto t0 = std::chrono::high_resolution_clock::now();
+      e.advanceState(input);
+      auto tf = std::chrono::high_resolution_clock::now();
+      auto &part = parts[partId];
+      part.ops++;
+      part.ns += getNanoseconds(t0, tf);
+    }
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  // Parsing command line arguments
+  argparse::ArgumentParser program("benchmark", "1.0");
+
+  program.add_argument("scriptFile")
+    .help("Path to the test script file to run.")
+    .required();
+
+  program.add_argument("sequenceFile")
+    .help("Path to the input sequence file (.sol) to replay.")
+    .required();
+
+  program.add_argument("--replays")
+    .help("Number of times the sequence is replayed for the interpreter and rendering benchmarks.")
+    .default_value(3)
+    .scan<'i', int>();
+
+  program.add_argument("--iterations")
+    .help("Number of operations timed in the state, hash and display benchmarks.")
+    .default_value(10000)
+    .scan<'i', int>();
+
+  program.add_argument("--unpackIterations")
+    .help("Number of times every bank is unpacked.")
+    .default_value(10)
+    .scan<'i', int>();
+
+  program.add_argument("--output")
+    .help("Path to write the results to, as JSON.")
+    .default_value(std::string(""));
+
+  program.add_argument("--compare")
+    .help("Path to the JSON results of another run (e.g. the other core) to compare against.")
+    .default_value(std::string(""));
+
+  // Try to parse arguments
+  try { program.parse_args(argc, argv); } catch (const std::runtime_error &err) { JAFFAR_THROW_LOGIC("%s\n%s", err.what(), program.help().str().c_str()); }
+
+  const auto scriptFilePath = program.get<std::string>("scriptFile");
+  const auto sequenceFilePath = program.get<std::string>("sequenceFile");
+  const auto replays = program.get<int>("--replays");
+  const auto iterations = program.get<int>("--iterations");
+  const auto unpackIterations = program.get<int>("--unpackIterations");
+  const auto outputFilePath = program.get<std::string>("--output");
+  const auto compareFilePath = program.get<std::string>("--compare");
+
+  if (replays <= 0) JAFFAR_THROW_LOGIC("Invalid replay count: %d\n", replays);
+  if (iterations <= 0) JAFFAR_THROW_LOGIC("Invalid iteration count: %d\n", iterations);
+  if (unpackIterations <= 0) JAFFAR_THROW_LOGIC("Invalid unpack iteration count: %d\n", unpackIterations);
+
+  // Loading the results to compare against first, so a bad path fails before running anything
+  nlohmann::json compareJs;
+  if (compareFilePath != "")
+  {
+    std::string compareJsRaw;
+    if (jaffarCommon::file::loadStringFromFile(compareJsRaw, compareFilePath) == false) JAFFAR_THROW_LOGIC("Could not find/read results file: %s\n", compareFilePath.c_str());
+    compareJs = nlohmann::json::parse(compareJsRaw);
+    if (compareJs.contains("Benchmarks") == false || compareJs["Benchmarks"].is_object() == false) JAFFAR_THROW_LOGIC("Results file '%s' has no 'Benchmarks' entry\n", compareFilePath.c_str());
+  }
+
+  // Loading script file
+  std::string configJsRaw;
+  if (jaffarCommon::file::loadStringFromFile(configJsRaw, scriptFilePath) == false) JAFFAR_THROW_LOGIC("Could not find/read script file: %s\n", scriptFilePath.c_str());
+  const auto configJs = nlohmann::json::parse(configJsRaw);
+  const auto initialStateFilePath = jaffarCommon::json::getString(configJs, "Initial State File");
+  const auto gameDataPath = jaffarCommon::json::getString(configJs, "Game Data Path");
+
+  // Creating and initializing emulator instance
+  auto e = rawspace::EmuInstance(configJs);
+  e.initialize(gameDataPath);
+  e.initializeVideoOutput();
+  e.disableRendering();
+
+  // If an initial state is provided, load it now
+  if (initialStateFilePath != "")
+  {
+    std::string stateFileData;
+    if (jaffarCommon::file::loadStringFromFile(stateFileData, initialStateFilePath) == false) JAFFAR_THROW_LOGIC("Could not initial state file: %s\n", initialStateFilePath.c_str());
+    jaffarCommon::deserializer::Contiguous d(stateFileData.data());
+    e.deserializeState(d);
+  }
+
+  // Keeping the full initial state (including video pages) to restart every replay from it
+  e.enableStateBlock("NVS");
+  const auto fullStateSize = e.getStateSize();
+  std::vector<uint8_t> initialState(fullStateSize);
+  {
+    jaffarCommon::serializer::Contiguous s(initialState.data(), fullStateSize);
+    e.serializeState(s);
+  }
+
+  // Loading sequence file
+  std::string sequenceRaw;
+  if (jaffarCommon::file::loadStringFromFile(sequenceRaw, sequenceFilePath) == false) JAFFAR_THROW_LOGIC("[ERROR] Could not find or read from input sequence file: %s\n", sequenceFilePath.c_str());
+  const auto sequence = jaffarCommon::string::split(sequenceRaw, ' ');
+  std::vector<jaffar::input_t> decodedSequence;
+  for (const auto &inputString : sequence) decodedSequence.push_back(e.getInputParser()->parseInputString(inputString));
+
+  printf("[] -----------------------------------------\n");
+  printf("[] Running Script:                         '%s'\n", scriptFilePath.c_str());
+  printf("[] Emulation Core:                         '%s'\n", e.getCoreName().c_str());
+  printf("[] Sequence File:                          '%s'\n", sequenceFilePath.c_str());
+  printf("[] Sequence Length:                        %lu\n", decodedSequence.size());
+  printf("[] Replays:                                %d\n", replays);
+  printf("[] Iterations:                             %d\n", iterations);
+  printf("[] ********** Running Benchmarks **********\n");
+  fflush(stdout);
+
+  std::vector<benchmarkResult_t> results;
+
+  // Interpreter and rendering, per game part
+  std::map<uint16_t, benchmarkResult_t> headlessParts, renderedParts;
+  e.disableRendering();
+  replaySequence(e, decodedSequence, initialState.data(), fullStateSize, replays, headlessParts);
+  e.enableRendering();
+  replaySequence(e, decodedSequence, initialState.data(), fullStateSize, replays, renderedParts);
+  e.disableRendering();
+
+  for (const auto &part : headlessParts)
+  {
+    const auto &rendered = renderedParts[part.first];
+    results.push_back({ "interpreter." + getPartName(part.first), part.second.ops, part.second.ns });
+    results.push_back({ "rendering." + getPartName(part.first), part.second.ops, std::max(0.0, rendered.ns - part.second.ns) });
+  }
+
+  // The sequence was replayed from the initial state, so both passes end on the same state
+  const auto finalStateHash = e.getStateHash();
+
+  // State serialization, with and without the non-VM state block. The last replayed state is used
+  for (const bool nvs : { true, false })
+  {
+    if (nvs) e.enableStateBlock("NVS");
+    else e.disableStateBlock("NVS");
+    const auto stateSize = e.getStateSize();
+    std::vector<uint8_t> state(stateSize);
+    const std::string suffix = nvs ? "full" : "vm";
+
+    results.push_back(measure("state.save." + suffix, iterations, [&]() { jaffarCommon::serializer::Contiguous s(state.data(), stateSize); e.serializeState(s); }));
+    results.push_back(measure("state.load." + suffix, iterations, [&]() { jaffarCommon::deserializer::Contiguous d(state.data(), stateSize); e.deserializeState(d); }));
+  }
+
+  // State hash
+  results.push_back(measure("state.hash", iterations, [&]() { const auto hash = e.getStateHash(); doNotOptimize(hash); }));
+
+  // Showing the current page
+  e.enableRendering();
+  results.push_back(measure("display.update", iterations, [&]() { ::e->video.updateDisplay(0xFE); }));
+  e.disableRendering();
+
+  // Unpacking, per bank. Buffers are large enough for the cores that unpack in place
+  {
+    Resource res(nullptr, gameDataPath.c_str());
+    res.readEntries();
+
+    std::map<uint8_t, std::vector<const MemEntry *>> banks;
+    for (uint16_t i = 0; i < res._numMemList; i++)
+    {
+      const MemEntry *me = &res._memList[i];
+      if (me->bankId == 0 || me->packedSize == me->size) continue;
+      banks[me->bankId].push_back(me);
+    }
+
+    Bank bk(gameDataPath.c_str());
+    for (const auto &bank : banks)
+    {
+      size_t bufferSize = 0;
+      for (const auto me : bank.second) bufferSize = std::max(bufferSize, (size_t)std::max(me->size, me->packedSize));
+      std::vector<uint8_t> buffer(bufferSize);
+
+      char name[32];
+      sprintf(name, "unpack.bank%02X", bank.first);
+      results.push_back(measure(name, unpackIterations, [&]()
+      {
+        for (const auto me : bank.second)
+          if (bk.read(me, buffer.data()) == false) JAFFAR_THROW_RUNTIME("Could not unpack entry %ld\n", me - res._memList);
+      }));
+    }
+  }
+
+  // Reporting
+  nlohmann::json resultsJs;
+  resultsJs["Emulation Core"] = e.getCoreName();
+  resultsJs["Script File"] = scriptFilePath;
+  resultsJs["Sequence File"] = sequenceFilePath;
+  char hashStringBuffer[256];
+  sprintf(hashStringBuffer, "0x%lX%lX", finalStateHash.first, finalStateHash.second);
+  resultsJs["Final State Hash"] = std::string(hashStringBuffer);
+
+  for (const auto &result : results)
+  {
+    const double nsPerOp = result.ops > 0 ? result.ns / (double)result.ops : 0.0;
+    resultsJs["Benchmarks"][result.name]["Operations"] = result.ops;
+    resultsJs["Benchmarks"][result.name]["Nanoseconds Per Operation"] = nsPerOp;
+    printf("[] %-40s%12.1f ns / op (%lu ops)\n", (result.name + ":").c_str(), nsPerOp, result.ops);
+  }
+  printf("[] Final State Hash:                       %s\n", hashStringBuffer);
+
+  // Comparing with the other results, on the benchmarks both have
+  if (compareFilePath != "")
+  {
+    printf("[] ********** Comparing with '%s' (%s) **********\n", compareFilePath.c_str(), compareJs.value("Emulation Core", std::string("?")).c_str());
+    if (compareJs.value("Final State Hash", std::string("")) != hashStringBuffer) printf("[] Warning: the final state hashes differ, the runs may not be comparable\n");
+    for (const auto &result : results)
+    {
+      if (compareJs["Benchmarks"].contains(result.name) == false) continue;
+      const double otherNsPerOp = compareJs["Benchmarks"][result.name]["Nanoseconds Per Operation"].get<double>();
+      const double nsPerOp = result.ops > 0 ? result.ns / (double)result.ops : 0.0;
+      printf("[] %-40s%12.1f -> %12.1f ns / op (%.2fx)\n", (result.name + ":").c_str(), otherNsPerOp, nsPerOp, nsPerOp > 0.0 ? otherNsPerOp / nsPerOp : 0.0);
+    }
+  }
+
+  if (outputFilePath != "")
+    if (jaffarCommon::file::saveStringToFile(resultsJs.dump(2) + "\n", outputFilePath.c_str()) == false) JAFFAR_THROW_RUNTIME("Could not write results to: %s\n", outputFilePath.c_str());
+
+  e.finalizeVideoOutput();
+}
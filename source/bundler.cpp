@@ -0,0 +1,65 @@
+#include "argparse/argparse.hpp"
+#include <jaffarCommon/exceptions.hpp>
+#include <cstdio>
+#include <string>
+#include <bundle.h>
+
+// Packs the game data (memlist, parts table and every resource unpacked) into a
+// single resource bundle, either as a binary file or as a C++ source to link in.
+
+int main(int argc, char *argv[])
+{
+  // Parsing command line arguments
+  argparse::ArgumentParser program("bundler", "1.0");
+
+  program.add_argument("gameDataPath")
+    .help("Path to the game data directory (memlist.bin and bank files).")
+    .required();
+
+  program.add_argument("outputFile")
+    .help("Path to write the bundle to.")
+    .required();
+
+  program.add_argument("--source")
+    .help("Writes a C++ source file defining the bundle symbols, instead of a binary file.")
+    .default_value(false)
+    .implicit_value(true);
+
+  program.add_argument("--threads")
+    .help("Number of threads used to unpack the resources.")
+    .default_value(1)
+    .scan<'i', int>();
+
+  // Try to parse arguments
+  try { program.parse_args(argc, argv); } catch (const std::runtime_error &err) { JAFFAR_THROW_LOGIC("%s\n%s", err.what(), program.help().str().c_str()); }
+
+  const auto gameDataPath = program.get<std::string>("gameDataPath");
+  const auto outputFile = program.get<std::string>("outputFile");
+  const auto asSource = program.get<bool>("--source");
+  const auto numThreads = program.get<int>("--threads");
+
+  // Building bundle
+  uint32_t size = 0;
+  uint8_t *data = ResourceBundle::build(gameDataPath.c_str(), &size, numThreads);
+
+  FILE *f = fopen(outputFile.c_str(), asSource ? "w" : "wb");
+  if (f == nullptr) JAFFAR_THROW_RUNTIME("Could not open output file: %s\n", outputFile.c_str());
+
+  if (asSource)
+  {
+    fprintf(f, "// Generated by the quickerNEORAW bundler from '%s'\n", gameDataPath.c_str());
+    fprintf(f, "#include <stdint.h>\n\n");
+    fprintf(f, "extern \"C\" const uint32_t quickerNEORAWBundleSize = %u;\n\n", size);
+    fprintf(f, "extern \"C\" const uint8_t quickerNEORAWBundleData[] = {\n");
+    for (uint32_t i = 0; i < size; i++) fprintf(f, "%s0x%02X,%s", i % 16 == 0 ? "  " : "", data[i], i % 16 == 15 || i == size - 1 ? "\n" : " ");
+    fprintf(f, "};\n");
+  }
+  else fwrite(data, 1, size, f);
+
+  const bool writeFailed = ferror(f) != 0;
+  fclose(f);
+  free(data);
+  if (writeFailed) JAFFAR_THROW_RUNTIME("Could not write output file: %s\n", outputFile.c_str());
+
+  printf("[] Bundle written to '%s' (%u bytes)\n", outputFile.c_str(), size);
+}
@@ -0,0 +1,531 @@
+#include "argparse/argparse.hpp"
+#include <jaffarCommon/json.hpp>
+#include <jaffarCommon/deserializers/contiguous.hpp>
+#include <jaffarCommon/string.hpp>
+#include <jaffarCommon/file.hpp>
+#include "NEORAWInstance.hpp"
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <string>
+
+// Headless video exporter: replays an input sequence with rendering enabled and streams
+// the frame shown after every input to a file or pipe, one frame at a time. Formats:
+//  - indexed: 320x200 palette indices (one byte each), then the 16 palette colors (RGB)
+//  - rgb:     320x200 RGB pixels (rawvideo rgb24)
+//  - y4m:     YUV4MPEG2 stream, 4:4:4 (BT.601, limited range)
+//
+// With --threads N, a headless pass (deferred rendering, no frames drawn) saves a full
+// state every --keyframeInterval inputs. Each of those segments is then rendered by one
+// of N workers, starting from its keyframe, and segments are written back in order.
+//
+// With --audioOutput, the audio of every frame is mixed offline (no audio device, at any speed)
+// and written to a mono WAV file. Frames last as long as the game shows them (20 ms per pause
+// slice), so each one is written as many times as it takes the video at --fps to catch up with
+// the audio (possibly none). Both streams then have the same length, to within half a frame.
+
+static const size_t FRAME_WIDTH = rawspace::EmuInstanceBase::OBSERVATION_WIDTH;
+static const size_t FRAME_HEIGHT = rawspace::EmuInstanceBase::OBSERVATION_HEIGHT;
+static const size_t FRAME_PIXELS = FRAME_WIDTH * FRAME_HEIGHT;
+
+// Size of one encoded frame
+static size_t getFrameSize(const std::string &format)
+{
+  if (format == "indexed") return FRAME_PIXELS + 16 * 3;
+  if (format == "rgb") return FRAME_PIXELS * 3;
+  return sizeof("FRAME\n") - 1 + FRAME_PIXELS * 3;
+}
+
+// Converts the current frame to the output format. Returns the number of bytes to write
+static size_t encodeFrame(const rawspace::EmuInstanceBase &e, const std::string &format, uint8_t *indices, uint32_t *rgba, uint8_t *output)
+{
+  if (format == "indexed")
+  {
+    e.getObservationIndexed(output);
+    const auto palette = e.getPalettePtr(); // 16 x (R, G, B, A)
+    for (size_t i = 0; i < 16; i++) memcpy(&output[FRAME_PIXELS + i * 3], &palette[i * 4], 3);
+    return FRAME_PIXELS + 16 * 3;
+  }
+
+  if (format == "rgb")
+  {
+    e.getObservation(rgba);
+    const auto pixels = (const uint8_t *)rgba;
+    for (size_t i = 0; i < FRAME_PIXELS; i++) memcpy(&output[i * 3], &pixels[i * 4], 3);
+    return FRAME_PIXELS * 3;
+  }
+
+  // y4m: frames only have 16 colors, so the palette is converted once and pixels are looked up
+  e.getObservationIndexed(indices);
+  uint8_t yuv[16][3];
+  const auto palette = e.getPalettePtr();
+  for (size_t i = 0; i < 16; i++)
+  {
+    const int r = palette[i * 4 + 0], g = palette[i * 4 + 1], b = palette[i * 4 + 2];
+    yuv[i][0] = (uint8_t)(16 + ((66 * r + 129 * g + 25 * b + 128) >> 8));
+    yuv[i][1] = (uint8_t)(128 + ((-38 * r - 74 * g + 112 * b + 128) >> 8));
+    yuv[i][2] = (uint8_t)(128 + ((112 * r - 94 * g - 18 * b + 128) >> 8));
+  }
+
+  const char frameHeader[] = "FRAME\n";
+  memcpy(output, frameHeader, sizeof(frameHeader) - 1);
+  uint8_t *planes = output + sizeof(frameHeader) - 1;
+  for (size_t i = 0; i < FRAME_PIXELS; i++)
+  {
+    const auto &c = yuv[indices[i] & 0xF];
+    planes[i] = c[0];
+    planes[FRAME_PIXELS + i] = c[1];
+    planes[FRAME_PIXELS * 2 + i] = c[2];
+  }
+  return sizeof(frameHeader) - 1 + FRAME_PIXELS * 3;
+}
+
+// WAV output: a canonical 44-byte header, with the sizes filled in once all samples are written
+struct wavOutput_t
+{
+  FILE *file = nullptr;
+  int bits = 8;
+  size_t sampleRate = 0;
+  size_t dataSize = 0;
+  std::vector<uint8_t> buffer;
+};
+
+// Keeps the video in step with the audio written so far. Returns how many times to write the last frame
+struct frameTiming_t
+{
+  size_t fps = 0;
+  size_t videoFrames = 0;
+};
+
+static size_t getFrameRepeats(frameTiming_t &timing, const wavOutput_t &wav)
+{
+  if (wav.file == nullptr) { timing.videoFrames++; return 1; }
+
+  const size_t audioSamples = wav.dataSize / (wav.bits / 8);
+  const size_t videoFrames = (audioSamples * timing.fps + wav.sampleRate / 2) / wav.sampleRate;
+  const size_t repeats = videoFrames - timing.videoFrames;
+  timing.videoFrames = videoFrames;
+  return repeats;
+}
+
+static void writeLE(uint8_t *p, uint32_t value, size_t bytes)
+{
+  for (size_t i = 0; i < bytes; i++) p[i] = (uint8_t)(value >> (8 * i));
+}
+
+static void writeWavHeader(wavOutput_t &wav, const std::string &path)
+{
+  const uint32_t sampleRate = wav.sampleRate;
+  const uint32_t bytesPerSample = wav.bits / 8;
+  uint8_t header[44];
+  memcpy(&header[0], "RIFF", 4);
+  writeLE(&header[4], 36 + wav.dataSize, 4);
+  memcpy(&header[8], "WAVEfmt ", 8);
+  writeLE(&header[16], 16, 4);                              // fmt chunk size
+  writeLE(&header[20], 1, 2);                               // PCM
+  writeLE(&header[22], 1, 2);                               // mono
+  writeLE(&header[24], sampleRate, 4);
+  writeLE(&header[28], sampleRate * bytesPerSample, 4);     // byte rate
+  writeLE(&header[32], bytesPerSample, 2);                  // block align
+  writeLE(&header[34], wav.bits, 2);
+  memcpy(&header[36], "data", 4);
+  writeLE(&header[40], wav.dataSize, 4);
+
+  if (fseek(wav.file, 0, SEEK_SET) != 0 || fwrite(header, 1, sizeof(header), wav.file) != sizeof(header)) JAFFAR_THROW_RUNTIME("Could not write WAV header to: %s\n", path.c_str());
+  fseek(wav.file, 0, SEEK_END);
+}
+
+// Appends the audio of the last frame. The mixer produces unsigned 8-bit samples, which is the WAV
+// 8-bit format already; 16-bit samples are signed
+static void writeFrameAudio(const rawspace::EmuInstanceBase &e, wavOutput_t &wav, const std::string &path)
+{
+  size_t sampleCount;
+  const uint8_t *samples = e.getFrameAudio(sampleCount);
+  if (sampleCount == 0) return;
+
+  const uint8_t *data = samples;
+  size_t dataSize = sampleCount;
+  if (wav.bits == 16)
+  {
+    wav.buffer.resize(sampleCount * 2);
+    for (size_t i = 0; i < sampleCount; i++) writeLE(&wav.buffer[i * 2], (uint16_t)((samples[i] - 128) * 256), 2);
+    data = wav.buffer.data();
+    dataSize = sampleCount * 2;
+  }
+
+  if (fwrite(data, 1, dataSize, wav.file) != dataSize) JAFFAR_THROW_RUNTIME("Could not write audio to: %s\n", path.c_str());
+  wav.dataSize += dataSize;
+}
+
+// Creates and initializes an emulator instance, loading the initial state if the script provides one.
+// The cores keep their state per thread, so an instance must be created and used on the same thread.
+// They also keep a pointer to the game data path, which must outlive the instance
+static std::unique_ptr<rawspace::EmuInstance> createInstance(const nlohmann::json &configJs, const std::string &gameDataPath)
+{
+  const auto initialStateFilePath = jaffarCommon::json::getString(configJs, "Initial State File");
+
+  auto e = std::make_unique<rawspace::EmuInstance>(configJs);
+  e->initialize(gameDataPath);
+  e->initializeVideoOutput();
+
+  if (initialStateFilePath != "")
+  {
+    std::string stateFileData;
+    if (jaffarCommon::file::loadStringFromFile(stateFileData, initialStateFilePath) == false) JAFFAR_THROW_LOGIC("Could not initial state file: %s\n", initialStateFilePath.c_str());
+    jaffarCommon::deserializer::Contiguous d(stateFileData.data());
+    e->deserializeState(d);
+  }
+
+  return e;
+}
+
+// Replays the whole sequence on a single instance, writing every frame as soon as it is drawn
+static void exportSequential(rawspace::EmuInstance &e, const std::vector<std::string> &sequence, const std::string &format, FILE *output, const std::string &outputFilePath, wavOutput_t &wav, const std::string &audioFilePath, frameTiming_t &timing)
+{
+  std::vector<uint8_t> indices(FRAME_PIXELS);
+  std::vector<uint32_t> rgba(FRAME_PIXELS);
+  std::vector<uint8_t> frame(getFrameSize(format));
+
+  e.enableRendering();
+  for (size_t i = 0; i < sequence.size(); i++)
+  {
+    e.advanceState(e.getInputParser()->parseInputString(sequence[i]));
+    const auto frameSize = encodeFrame(e, format, indices.data(), rgba.data(), frame.data());
+    if (wav.file != nullptr) writeFrameAudio(e, wav, audioFilePath);
+    const auto repeats = getFrameRepeats(timing, wav);
+    for (size_t r = 0; r < repeats; r++)
+      if (fwrite(frame.data(), 1, frameSize, output) != frameSize) JAFFAR_THROW_RUNTIME("Could not write frame %lu to: %s\n", i, outputFilePath.c_str());
+  }
+}
+
+// A run of inputs rendered by a single worker, starting from the full state saved before its first input
+struct segment_t
+{
+  size_t begin;
+  size_t end;
+  std::vector<uint8_t> keyframe;
+  std::vector<uint8_t> frames;
+  bool rendered = false;
+};
+
+// Renders the sequence in segments on 'threadCount' workers. Rendered segments are held in memory until
+// all the ones before them are written, so at most 'maxSegmentsInFlight' segments are taken at once.
+// Audio only needs the frames in order, so the keyframe pass mixes and writes it while going through them,
+// and tells the writer how many times each frame is written
+static void exportParallel(const nlohmann::json &configJs, const std::string &gameDataPath, const std::vector<std::string> &sequence, const std::string &format, FILE *output, const std::string &outputFilePath, const size_t threadCount, const size_t keyframeInterval, wavOutput_t &wav, const std::string &audioFilePath, frameTiming_t &timing)
+{
+  const size_t segmentCount = (sequence.size() + keyframeInterval - 1) / keyframeInterval;
+  const size_t maxSegmentsInFlight = threadCount * 2;
+
+  std::vector<segment_t> segments(segmentCount);
+  for (size_t i = 0; i < segmentCount; i++)
+  {
+    segments[i].begin = i * keyframeInterval;
+    segments[i].end = std::min(sequence.size(), (i + 1) * keyframeInterval);
+  }
+
+  std::mutex mutex;
+  std::condition_variable condition;
+  size_t keyframesSaved = 0;
+  size_t segmentsTaken = 0;
+  size_t segmentsWritten = 0;
+
+  // Times each frame is written, known once the keyframe pass has gone through its input
+  std::vector<size_t> frameRepeats(sequence.size(), 1);
+  size_t framesTimed = wav.file != nullptr ? 0 : sequence.size();
+
+  // Frame buffers are recycled once written, as allocating (and page faulting) one per segment is slow
+  std::vector<std::vector<uint8_t>> freeFrameBuffers;
+
+  // Keyframe pass: nothing is drawn, pending draw calls are only replayed when a state is saved
+  auto keyframeProducer = [&]()
+  {
+    auto e = createInstance(configJs, gameDataPath);
+    e->enableStateBlock("NVS");
+    e->disableRendering();
+    const auto stateSize = e->getStateSize();
+
+    for (size_t i = 0; i < segmentCount; i++)
+    {
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [&]() { return i < segmentsWritten + maxSegmentsInFlight; });
+      }
+
+      std::vector<uint8_t> keyframe(stateSize);
+      jaffarCommon::serializer::Contiguous s(keyframe.data(), stateSize);
+      e->serializeState(s);
+
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        segments[i].keyframe = std::move(keyframe);
+        keyframesSaved = i + 1;
+      }
+      condition.notify_all();
+
+      // The last segment's inputs are not needed here, unless for its audio
+      if (i + 1 < segmentCount || wav.file != nullptr)
+        for (size_t j = segments[i].begin; j < segments[i].end; j++)
+        {
+          e->advanceState(e->getInputParser()->parseInputString(sequence[j]));
+          if (wav.file != nullptr)
+          {
+            writeFrameAudio(*e, wav, audioFilePath);
+            frameRepeats[j] = getFrameRepeats(timing, wav);
+          }
+        }
+
+      if (wav.file != nullptr)
+      {
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          framesTimed = segments[i].end;
+        }
+        condition.notify_all();
+      }
+    }
+
+    e->finalizeVideoOutput();
+  };
+
+  // Workers do not need the audio
+  auto workerConfigJs = configJs;
+  workerConfigJs["Offline Audio"] = false;
+
+  auto segmentRenderer = [&]()
+  {
+    auto e = createInstance(workerConfigJs, gameDataPath);
+    e->enableStateBlock("NVS");
+    e->enableRendering();
+
+    std::vector<uint8_t> indices(FRAME_PIXELS);
+    std::vector<uint32_t> rgba(FRAME_PIXELS);
+    std::vector<uint8_t> frames;
+
+    while (true)
+    {
+      size_t i;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        condition.wait(lock, [&]() { return segmentsTaken == segmentCount || segmentsTaken < keyframesSaved; });
+        if (segmentsTaken == segmentCount) break;
+        i = segmentsTaken++;
+        if (freeFrameBuffers.empty() == false)
+        {
+          frames = std::move(freeFrameBuffers.back());
+          freeFrameBuffers.pop_back();
+        }
+      }
+
+      auto &segment = segments[i];
+      jaffarCommon::deserializer::Contiguous d(segment.keyframe.data(), segment.keyframe.size());
+      e->deserializeState(d);
+
+      frames.resize((segment.end - segment.begin) * getFrameSize(format));
+      size_t framesSize = 0;
+      for (size_t j = segment.begin; j < segment.end; j++)
+      {
+        e->advanceState(e->getInputParser()->parseInputString(sequence[j]));
+        framesSize += encodeFrame(*e, format, indices.data(), rgba.data(), &frames[framesSize]);
+      }
+
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        segment.frames = std::move(frames);
+        segment.keyframe = std::vector<uint8_t>();
+        segment.rendered = true;
+      }
+      condition.notify_all();
+    }
+
+    e->finalizeVideoOutput();
+  };
+
+  std::vector<std::thread> threads;
+  threads.emplace_back(keyframeProducer);
+  for (size_t t = 0; t < threadCount; t++) threads.emplace_back(segmentRenderer);
+
+  // Writing segments back in order, as they complete
+  const size_t frameSize = getFrameSize(format);
+  for (size_t i = 0; i < segmentCount; i++)
+  {
+    std::vector<uint8_t> frames;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      condition.wait(lock, [&]() { return segments[i].rendered && framesTimed >= segments[i].end; });
+      frames = std::move(segments[i].frames);
+    }
+
+    if (wav.file == nullptr)
+    {
+      if (fwrite(frames.data(), 1, frames.size(), output) != frames.size()) JAFFAR_THROW_RUNTIME("Could not write frames %lu-%lu to: %s\n", segments[i].begin, segments[i].end - 1, outputFilePath.c_str());
+    }
+    else for (size_t j = segments[i].begin; j < segments[i].end; j++)
+      for (size_t r = 0; r < frameRepeats[j]; r++)
+        if (fwrite(&frames[(j - segments[i].begin) * frameSize], 1, frameSize, output) != frameSize) JAFFAR_THROW_RUNTIME("Could not write frame %lu to: %s\n", j, outputFilePath.c_str());
+
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      segmentsWritten = i + 1;
+      freeFrameBuffers.push_back(std::move(frames));
+    }
+    condition.notify_all();
+  }
+
+  for (auto &thread : threads) thread.join();
+
+  // Without audio, every frame is written once
+  if (wav.file == nullptr) timing.videoFrames = sequence.size();
+}
+
+int main(int argc, char *argv[])
+{
+  // Parsing command line arguments
+  argparse::ArgumentParser program("exporter", "1.0");
+
+  program.add_argument("scriptFile")
+    .help("Path to the test script file to run.")
+    .required();
+
+  program.add_argument("sequenceFile")
+    .help("Path to the input sequence file (.sol) to export.")
+    .required();
+
+  program.add_argument("outputFile")
+    .help("Path to the output file, or '-' to write to the standard output.")
+    .required();
+
+  program.add_argument("--format")
+    .help("Output format. Possible values: 'indexed': palette indices and palette, 'rgb': raw rgb24 pixels, 'y4m': YUV4MPEG2 stream.")
+    .default_value(std::string("y4m"));
+
+  program.add_argument("--fps")
+    .help("Frame rate of the video output, written in the YUV4MPEG2 header. With --audioOutput, frames are repeated or dropped to last as long as the audio at this rate.")
+    .default_value(50)
+    .scan<'i', int>();
+
+  program.add_argument("--threads")
+    .help("Number of threads rendering segments in parallel. Values above 1 need a core with deferred rendering and a headless build (useSDL=false).")
+    .default_value(1)
+    .scan<'i', int>();
+
+  program.add_argument("--keyframeInterval")
+    .help("Number of inputs in each segment rendered from a keyframe, when using more than one thread.")
+    .default_value(100)
+    .scan<'i', int>();
+
+  program.add_argument("--audioOutput")
+    .help("Path to a WAV file to write the game audio to, mixed offline. Needs a core with offline audio.")
+    .default_value(std::string(""));
+
+  program.add_argument("--audioBits")
+    .help("Bits per sample of the WAV audio output. Possible values: 8, 16.")
+    .default_value(16)
+    .scan<'i', int>();
+
+  // Try to parse arguments
+  try { program.parse_args(argc, argv); } catch (const std::runtime_error &err) { JAFFAR_THROW_LOGIC("%s\n%s", err.what(), program.help().str().c_str()); }
+
+  const auto scriptFilePath = program.get<std::string>("scriptFile");
+  const auto sequenceFilePath = program.get<std::string>("sequenceFile");
+  const auto outputFilePath = program.get<std::string>("outputFile");
+  const auto format = program.get<std::string>("--format");
+  const auto fps = program.get<int>("--fps");
+  const auto threadCount = program.get<int>("--threads");
+  const auto keyframeInterval = program.get<int>("--keyframeInterval");
+  const auto audioFilePath = program.get<std::string>("--audioOutput");
+  const auto audioBits = program.get<int>("--audioBits");
+
+  bool formatRecognized = false;
+  if (format == "indexed") formatRecognized = true;
+  if (format == "rgb") formatRecognized = true;
+  if (format == "y4m") formatRecognized = true;
+  if (formatRecognized == false) JAFFAR_THROW_LOGIC("Unrecognized output format: %s\n", format.c_str());
+  if (fps <= 0) JAFFAR_THROW_LOGIC("Invalid frame rate: %d\n", fps);
+  if (threadCount <= 0) JAFFAR_THROW_LOGIC("Invalid thread count: %d\n", threadCount);
+  if (keyframeInterval <= 0) JAFFAR_THROW_LOGIC("Invalid keyframe interval: %d\n", keyframeInterval);
+  if (audioBits != 8 && audioBits != 16) JAFFAR_THROW_LOGIC("Invalid audio bits per sample: %d\n", audioBits);
+
+  // Loading script file
+  std::string configJsRaw;
+  if (jaffarCommon::file::loadStringFromFile(configJsRaw, scriptFilePath) == false) JAFFAR_THROW_LOGIC("Could not find/read script file: %s\n", scriptFilePath.c_str());
+  auto configJs = nlohmann::json::parse(configJsRaw);
+
+  // Parallel rendering restarts from keyframes, which the headless pass saves without drawing every frame
+  if (threadCount > 1) configJs["Deferred Rendering"] = true;
+  if (audioFilePath != "") configJs["Offline Audio"] = true;
+  const auto gameDataPath = jaffarCommon::json::getString(configJs, "Game Data Path");
+
+  // Loading sequence file
+  std::string sequenceRaw;
+  if (jaffarCommon::file::loadStringFromFile(sequenceRaw, sequenceFilePath) == false) JAFFAR_THROW_LOGIC("[ERROR] Could not find or read from input sequence file: %s\n", sequenceFilePath.c_str());
+  const auto sequence = jaffarCommon::string::split(sequenceRaw, ' ');
+
+  // Creating and initializing emulator instance. With multiple threads, it is only used on this thread to report
+  // on the core and each worker creates its own
+  auto e = createInstance(configJs, gameDataPath);
+  if (threadCount > 1 && e->isHeadless() == false) JAFFAR_THROW_LOGIC("Core '%s' is not headless: --threads needs a build with the NullSystem backend (-DuseSDL=false)\n", e->getCoreName().c_str());
+  if (threadCount > 1 && e->isDeferredRenderingEnabled() == false) JAFFAR_THROW_LOGIC("Core '%s' does not support deferred rendering, needed by --threads\n", e->getCoreName().c_str());
+  if (audioFilePath != "" && e->isOfflineAudioEnabled() == false) JAFFAR_THROW_LOGIC("Core '%s' does not support offline audio, needed by --audioOutput\n", e->getCoreName().c_str());
+
+  // Opening output. Progress goes to the standard error, as the standard output may carry the video
+  FILE *output = outputFilePath == "-" ? stdout : fopen(outputFilePath.c_str(), "wb");
+  if (output == nullptr) JAFFAR_THROW_RUNTIME("Could not open output file: %s\n", outputFilePath.c_str());
+
+  // The WAV header is written again at the end, with the final sizes
+  wavOutput_t wav;
+  wav.bits = audioBits;
+  wav.sampleRate = e->getAudioSampleRate();
+  if (audioFilePath != "")
+  {
+    wav.file = fopen(audioFilePath.c_str(), "wb");
+    if (wav.file == nullptr) JAFFAR_THROW_RUNTIME("Could not open audio output file: %s\n", audioFilePath.c_str());
+    writeWavHeader(wav, audioFilePath);
+  }
+
+  frameTiming_t timing;
+  timing.fps = fps;
+
+  fprintf(stderr, "[] -----------------------------------------\n");
+  fprintf(stderr, "[] Running Script:                         '%s'\n", scriptFilePath.c_str());
+  fprintf(stderr, "[] Emulation Core:                         '%s'\n", e->getCoreName().c_str());
+  fprintf(stderr, "[] Sequence File:                          '%s'\n", sequenceFilePath.c_str());
+  fprintf(stderr, "[] Sequence Length:                        %lu\n", sequence.size());
+  fprintf(stderr, "[] Output File:                            '%s'\n", outputFilePath.c_str());
+  fprintf(stderr, "[] Output Format:                          '%s'\n", format.c_str());
+  fprintf(stderr, "[] Threads:                                %d\n", threadCount);
+  if (threadCount > 1) fprintf(stderr, "[] Keyframe Interval:                      %d\n", keyframeInterval);
+  if (wav.file != nullptr) fprintf(stderr, "[] Audio Output File:                      '%s' (%lu Hz, %d bits)\n", audioFilePath.c_str(), e->getAudioSampleRate(), audioBits);
+  fprintf(stderr, "[] ********** Exporting Frames **********\n");
+
+  if (format == "y4m") fprintf(output, "YUV4MPEG2 W%lu H%lu F%d:1 Ip A1:1 C444\n", FRAME_WIDTH, FRAME_HEIGHT, fps);
+
+  if (threadCount == 1) exportSequential(*e, sequence, format, output, outputFilePath, wav, audioFilePath, timing);
+  else exportParallel(configJs, gameDataPath, sequence, format, output, outputFilePath, threadCount, keyframeInterval, wav, audioFilePath, timing);
+
+  if (output != stdout) fclose(output);
+  else fflush(output);
+
+  fprintf(stderr, "[] Frames Written:                         %lu\n", timing.videoFrames);
+
+  if (wav.file != nullptr)
+  {
+    writeWavHeader(wav, audioFilePath);
+    fclose(wav.file);
+
+    // Video and audio must last the same, to within the half frame the repeats are rounded to
+    const size_t audioSamples = wav.dataSize / (audioBits / 8);
+    const double audioSeconds = (double)audioSamples / (double)wav.sampleRate;
+    const double videoSeconds = (double)timing.videoFrames / (double)fps;
+    fprintf(stderr, "[] Audio Samples Written:                  %lu\n", audioSamples);
+    fprintf(stderr, "[] Video / Audio Duration:                 %.3fs / %.3fs\n", videoSeconds, audioSeconds);
+    if (std::abs(videoSeconds - audioSeconds) > 0.5 / (double)fps + 1.0e-9) JAFFAR_THROW_RUNTIME("Video (%.3fs) and audio (%.3fs) durations differ by more than half a frame\n", videoSeconds, audioSeconds);
+  }
+
+  e->finalizeVideoOutput();
+}
@@ -1,15 +1,18 @@
 #pragma once
 
 #include "../NEORAWInstanceBase.hpp"
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <jaffarCommon/exceptions.hpp>
 #include <jaffarCommon/file.hpp>
+#include <jaffarCommon/json.hpp>
 #include <jaffarCommon/serializers/base.hpp>
 #include <jaffarCommon/serializers/contiguous.hpp>
 #include <jaffarCommon/deserializers/base.hpp>
 
 #include <engine.h>
+#include <bundle.h>
 #include <sys.h>
 
 extern thread_local System *stub ;//= System_SDL_create();
@@ -24,6 +27,41 @@ class EmuInstance : public EmuInstanceBase
 
   EmuInstance(const nlohmann::json &config) : EmuInstanceBase(config)
   {
+    // Optional: pre-unpacked resource cache file (created on first use)
+    if (config.contains("Resource Cache File")) _resourceCacheFile = jaffarCommon::json::getString(config, "Resource Cache File");
+
+    // Optional: resource bundle file to use instead of the game data files ('<linked>' for the one linked in)
+    if (config.contains("Resource Bundle")) _resourceBundle = jaffarCommon::json::getString(config, "Resource Bundle");
+
+    // Optional: unpack every resource at initialization, on this many threads
+    if (config.contains("Resource Preload Threads"))
+    {
+      if (config["Resource Preload Threads"].is_number() == false) JAFFAR_THROW_LOGIC("Script file 'Resource Preload Threads' entry is not a number\n");
+      _resourcePreloadThreads = config["Resource Preload Threads"].get<int>();
+    }
+
+    // Optional: while rendering is disabled, record draw calls and only draw them when pixels are requested
+    if (config.contains("Deferred Rendering"))
+    {
+      if (config["Deferred Rendering"].is_boolean() == false) JAFFAR_THROW_LOGIC("Script file 'Deferred Rendering' entry is not a boolean\n");
+      _deferredRendering = config["Deferred Rendering"].get<bool>();
+    }
+
+    // Optional: mix the audio of every frame, in step with the game instead of an audio device
+    if (config.contains("Offline Audio"))
+    {
+      if (config["Offline Audio"].is_boolean() == false) JAFFAR_THROW_LOGIC("Script file 'Offline Audio' entry is not a boolean\n");
+      _offlineAudio = config["Offline Audio"].get<bool>();
+    }
+
+    // Optional: play the music from the VM frames, so scripts see its marks (the reference core never plays it).
+    // With the NVS block disabled, states must be loaded with the same resources loaded (the same game part) as
+    // when saved, as the music module is prepared from them. Otherwise the music stops on load
+    if (config.contains("Music Clock"))
+    {
+      if (config["Music Clock"].is_boolean() == false) JAFFAR_THROW_LOGIC("Script file 'Music Clock' entry is not a boolean\n");
+      _musicClock = config["Music Clock"].get<bool>();
+    }
   }
 
   ~EmuInstance()
@@ -38,6 +76,17 @@ class EmuInstance : public EmuInstanceBase
   virtual void initializeImpl(const std::string& gameDataPath) override
   {
     e = new Engine(stub, gameDataPath.c_str(), "");
+    if (_resourceCacheFile.empty() == false) e->res._cacheFile = _resourceCacheFile.c_str();
+    e->res._preloadThreads = _resourcePreloadThreads;
+    if (_resourceBundle == "<linked>")
+    {
+      e->res._bundle = ResourceBundle::getLinked();
+      if (e->res._bundle == nullptr) JAFFAR_THROW_LOGIC("No resource bundle was linked into the core\n");
+    }
+    else if (_resourceBundle.empty() == false) e->res._bundle = ResourceBundle::open(_resourceBundle.c_str());
+    e->video._deferRendering = _deferredRendering;
+    e->_offlineAudio = _offlineAudio;
+    e->_musicClock = _musicClock;
     e->init();
   }
 
@@ -53,6 +102,7 @@ class EmuInstance : public EmuInstanceBase
 
   void enableRendering() override
   {
+    e->video.rasterize();
     e->vm._doRendering = true;
     e->video._doRendering = true;
   }
@@ -63,7 +113,36 @@ class EmuInstance : public EmuInstanceBase
     e->video._doRendering = false;
   }
 
-  uint8_t* getPixelsPtr() const override { return stub->getPixelsPtr(); }
+  bool isDeferredRenderingEnabled() const override { return e->video._deferRendering; }
+  bool isHeadless() const override { return stub->isHeadless(); }
+
+  bool isOfflineAudioEnabled() const override { return e->_offlineAudio; }
+  size_t getAudioSampleRate() const override { return stub->getOutputSampleRate(); }
+  const uint8_t* getFrameAudio(size_t &sampleCount) const override { sampleCount = _frameAudioSamples; return _frameAudio.data(); }
+
+  std::vector<std::pair<std::string, uint64_t>> getResourceCounters() const override
+  {
+    const auto &c = e->res._counters;
+    return {
+      { "Read Bank Calls", c.readBankCalls },
+      { "Resource Cache Hits", c.cacheHits },
+      { "Bytes Read", c.bytesRead },
+      { "Bytes Unpacked", c.bytesUnpacked },
+      { "Bank Read Time (ns)", c.unpackNs },
+      { "Part Switches", c.partSwitches },
+      { "Part Snapshot Hits", c.partSnapshotHits },
+      { "Part Switch Time (ns)", c.partSwitchNs },
+      { "State Load Entry Reads", c.stateLoadReads },
+    };
+  }
+
+  void resetResourceCounters() override { memset(&e->res._counters, 0, sizeof(e->res._counters)); }
+
+  // Pending deferred draw calls are drawn before any pixels are handed out
+  void getObservationIndexed(uint8_t *indices) const override { e->video.rasterize(); e->video.getObservationIndexed(indices); }
+  void getObservation(uint32_t *rgba) const override { e->video.rasterize(); e->video.getObservation(rgba); }
+
+  uint8_t* getPixelsPtr() const override { e->video.rasterize(); return stub->getPixelsPtr(); }
   size_t getPixelsSize() const override { return stub->getPixelsSize(); }
   uint8_t* getPalettePtr() const override { return stub->getPalettePtr(); }
   size_t getPaletteSize() const override { return stub->getPaletteSize(); }
@@ -87,6 +166,7 @@ class EmuInstance : public EmuInstanceBase
 
   void updateRenderer() override
   {
+    e->video.rasterize();
     stub->applyPalette();
     stub->updateRenderer();
   }
@@ -124,6 +204,9 @@ void enableStateBlockImpl(const std::string& block)
 
   uint8_t* getRamPointer() const override { return (uint8_t*)e->vm.vmVariables; }
 
+  // The resource memory block (MEM_BLOCK_SIZE), where the scripts, palettes, polygons and bitmaps of the parts are loaded
+  const uint8_t* getLargestAllocationPtr() const override { return e->res._memPtrStart; }
+
   void advanceStateImpl(const jaffar::input_t &input) override
   {
 		e->vm.checkThreadRequests();
@@ -131,10 +214,24 @@ void enableStateBlockImpl(const std::string& block)
 		e->vm.inp_updatePlayer(input.buttonUp, input.buttonDown, input.buttonLeft, input.buttonRight, input.buttonFire);
 
 		e->vm.hostFrame();
+
+		if (_offlineAudio)
+		{
+			_frameAudio.resize(std::max(_frameAudio.size(), (size_t)e->getFrameAudioSamples()));
+			_frameAudioSamples = e->mixFrameAudio((int8_t*)_frameAudio.data());
+		}
   }
 
   private:
 
+  std::string _resourceCacheFile;
+  int _resourcePreloadThreads = 0;
+  std::string _resourceBundle;
+  bool _deferredRendering = false;
+  bool _offlineAudio = false;
+  bool _musicClock = false;
+  std::vector<uint8_t> _frameAudio;
+  size_t _frameAudioSamples = 0;
 };
 
 } // namespace rawspace
\ No newline at end of file
@@ -30,7 +30,7 @@ bool Bank::read(const MemEntry *me, uint8_t *buf) {
 	bool ret = false;
 	char bankName[10];
 	sprintf(bankName, "bank%02x", me->bankId);
-	File f;
+	File f(false, true);
 
 	if (!f.open(bankName, _dataDir))
 		error("Bank::read() unable to open '%s'", bankName);
@@ -38,27 +38,70 @@ bool Bank::read(const MemEntry *me, uint8_t *buf) {
 	
 	f.seek(me->bankOffset);
 
+	// The bank is memory mapped: take the resource data from it in place
+	const uint8_t *src = f.map(me->packedSize);
+	if (!src)
+		error("Bank::read() unable to read %d bytes at 0x%X from '%s'", me->packedSize, me->bankOffset, bankName);
+
 	// Depending if the resource is packed or not we
 	// can read directly or unpack it.
 	if (me->packedSize == me->size) {
-		f.read(buf, me->packedSize);
+		memcpy(buf, src, me->packedSize);
 		ret = true;
 	} else {
-		f.read(buf, me->packedSize);
 		_startBuf = buf;
-		_iBuf = buf + me->packedSize - 4;
+		_iStartBuf = src;
+		_iBuf = src + me->packedSize - 4;
 		ret = unpack();
 	}
 	
 	return ret;
 }
 
-void Bank::decUnk1(uint8_t numChunks, uint8_t addCount) {
-	uint16_t count = getCode(numChunks) + addCount + 1;
-	debug(DBG_BANK, "Bank::decUnk1(%d, %d) count=%d", numChunks, addCount, count);
-	_unpCtx.datasize -= count;
+/*
+	The packed stream is read backwards, one 32 bits word at a time, and its bits
+	are consumed from the least significant one. Words are bit reversed when
+	loaded into the 64 bits buffer so a code of any size is a single shift.
+	Words are still only loaded once their first bit is needed: the CRC covers
+	exactly the same words as the original bit by bit reader.
+*/
+static inline uint32_t reverseBits(uint32_t x) {
+	x = ((x >> 1) & 0x55555555) | ((x & 0x55555555) << 1);
+	x = ((x >> 2) & 0x33333333) | ((x & 0x33333333) << 2);
+	x = ((x >> 4) & 0x0F0F0F0F) | ((x & 0x0F0F0F0F) << 4);
+	x = ((x >> 8) & 0x00FF00FF) | ((x & 0x00FF00FF) << 8);
+	return (x >> 16) | (x << 16);
+}
+
+inline void Bank::refill() {
+	assert(_iBuf >= _iStartBuf);
+	uint32_t chk = READ_BE_UINT32(_iBuf); _iBuf -= 4;
+	_unpCtx.crc ^= chk;
+	_unpCtx.bits |= (uint64_t)reverseBits(chk) << (32 - _unpCtx.numBits);
+	_unpCtx.numBits += 32;
+}
+
+inline uint16_t Bank::peekCode(uint8_t numBits) {
+	if (_unpCtx.numBits < numBits) {
+		refill();
+	}
+	return _unpCtx.bits >> (64 - numBits);
+}
+
+inline uint16_t Bank::getCode(uint8_t numBits) {
+	uint16_t c = peekCode(numBits);
+	_unpCtx.bits <<= numBits;
+	_unpCtx.numBits -= numBits;
+	return c;
+}
+
+/*
+	Copies 'count' literal bytes from the stream.
+*/
+void Bank::decUnk1(uint16_t count) {
+	debug(DBG_BANK, "Bank::decUnk1() count=%d", count);
+	assert(_oBuf - _startBuf + 1 >= count);
 	while (count--) {
-		assert(_oBuf >= _iBuf && _oBuf >= _startBuf);
 		*_oBuf = (uint8_t)getCode(8);
 		--_oBuf;
 	}
@@ -66,80 +109,73 @@ void Bank::decUnk1(uint8_t numChunks, uint8_t addCount) {
 
 /*
    Note from fab: This look like run-length encoding.
+   Copies 'count' bytes already unpacked 'offset' bytes above. They can overlap.
 */
-void Bank::decUnk2(uint8_t numChunks) {
-	uint16_t i = getCode(numChunks);
-	uint16_t count = _unpCtx.size + 1;
-	debug(DBG_BANK, "Bank::decUnk2(%d) i=%d count=%d", numChunks, i, count);
-	_unpCtx.datasize -= count;
+void Bank::decUnk2(uint16_t offset, uint16_t count) {
+	debug(DBG_BANK, "Bank::decUnk2() i=%d count=%d", offset, count);
+	assert(_oBuf - _startBuf + 1 >= count);
 	while (count--) {
-		assert(_oBuf >= _iBuf && _oBuf >= _startBuf);
-		*_oBuf = *(_oBuf + i);
+		*_oBuf = *(_oBuf + offset);
 		--_oBuf;
 	}
 }
 
+/*
+	Control codes, indexed by the next 3 bits of the stream. Every code is
+	followed by at least 3 more bits, so peeking 3 bits never loads a word the
+	bit by bit reader would not have loaded.
+*/
+struct UnpackCode {
+	uint8_t len;        // Bits taken by the control code itself
+	uint8_t countBits;  // Bits of the variable part of the count (0 if fixed)
+	uint8_t countAdd;
+	uint8_t offsetBits; // 0 for literals
+};
+
+static const UnpackCode _unpackCodes[8] = {
+	{ 2, 3, 1,  0 }, // 00x : 1..8 literals
+	{ 2, 3, 1,  0 },
+	{ 2, 0, 2,  8 }, // 01x : copy 2 bytes
+	{ 2, 0, 2,  8 },
+	{ 3, 0, 3,  9 }, // 100 : copy 3 bytes
+	{ 3, 0, 4, 10 }, // 101 : copy 4 bytes
+	{ 3, 8, 1, 12 }, // 110 : copy 1..256 bytes
+	{ 3, 8, 9,  0 }  // 111 : 9..264 literals
+};
+
 /*
 	Most resource in the banks are compacted.
 */
 bool Bank::unpack() {
-	_unpCtx.size = 0;
 	_unpCtx.datasize = READ_BE_UINT32(_iBuf); _iBuf -= 4;
 	_oBuf = _startBuf + _unpCtx.datasize - 1;
 	_unpCtx.crc = READ_BE_UINT32(_iBuf); _iBuf -= 4;
-	_unpCtx.chk = READ_BE_UINT32(_iBuf); _iBuf -= 4;
-	_unpCtx.crc ^= _unpCtx.chk;
+
+	// The first word only holds the bits below its highest set one
+	uint32_t chk = READ_BE_UINT32(_iBuf); _iBuf -= 4;
+	_unpCtx.crc ^= chk;
+	_unpCtx.numBits = 0;
+	while ((uint64_t)chk >> (_unpCtx.numBits + 1)) {
+		++_unpCtx.numBits;
+	}
+	_unpCtx.bits = _unpCtx.numBits ? (uint64_t)(reverseBits(chk) >> (32 - _unpCtx.numBits)) << (64 - _unpCtx.numBits) : 0;
+
 	do {
-		if (!nextChunk()) {
-			_unpCtx.size = 1;
-			if (!nextChunk()) {
-				decUnk1(3, 0);
-			} else {
-				decUnk2(8);
-			}
+		const UnpackCode *code = &_unpackCodes[peekCode(3)];
+		_unpCtx.bits <<= code->len;
+		_unpCtx.numBits -= code->len;
+
+		uint16_t count = code->countAdd;
+		if (code->countBits) {
+			count += getCode(code->countBits);
+		}
+		_unpCtx.datasize -= count;
+
+		if (code->offsetBits) {
+			decUnk2(getCode(code->offsetBits), count);
 		} else {
-			uint16_t c = getCode(2);
-			if (c == 3) {
-				decUnk1(8, 8);
-			} else {
-				if (c < 2) {
-					_unpCtx.size = c + 2;
-					decUnk2(c + 9);
-				} else {
-					_unpCtx.size = getCode(8);
-					decUnk2(12);
-				}
-			}
+			decUnk1(count);
 		}
 	} while (_unpCtx.datasize > 0);
 	return (_unpCtx.crc == 0);
 }
-
-uint16_t Bank::getCode(uint8_t numChunks) {
-	uint16_t c = 0;
-	while (numChunks--) {
-		c <<= 1;
-		if (nextChunk()) {
-			c |= 1;
-		}			
-	}
-	return c;
-}
-
-bool Bank::nextChunk() {
-	bool CF = rcr(false);
-	if (_unpCtx.chk == 0) {
-		assert(_iBuf >= _startBuf);
-		_unpCtx.chk = READ_BE_UINT32(_iBuf); _iBuf -= 4;
-		_unpCtx.crc ^= _unpCtx.chk;
-		CF = rcr(true);
-	}
-	return CF;
-}
-
-bool Bank::rcr(bool CF) {
-	bool rCF = (_unpCtx.chk & 1);
-	_unpCtx.chk >>= 1;
-	if (CF) _unpCtx.chk |= 0x80000000;
-	return rCF;
-}
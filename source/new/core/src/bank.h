@@ -24,26 +24,27 @@
 struct MemEntry;
 
 struct UnpackContext {
-	uint16_t size;
+	uint64_t bits;     // Pending input bits, in reading order from bit 63 down
+	uint8_t numBits;
 	uint32_t crc;
-	uint32_t chk;
 	int32_t datasize;
 };
 
 struct Bank {
 	UnpackContext _unpCtx;
 	const char *_dataDir;
-	uint8_t *_iBuf, *_oBuf, *_startBuf;
+	const uint8_t *_iBuf, *_iStartBuf;
+	uint8_t *_oBuf, *_startBuf;
 
 	Bank(const char *dataDir);
 
 	bool read(const MemEntry *me, uint8_t *buf);
-	void decUnk1(uint8_t numChunks, uint8_t addCount);
-	void decUnk2(uint8_t numChunks);
+	void decUnk1(uint16_t count);
+	void decUnk2(uint16_t offset, uint16_t count);
 	bool unpack();
-	uint16_t getCode(uint8_t numChunks);
-	bool nextChunk();
-	bool rcr(bool CF);
+	void refill();
+	uint16_t peekCode(uint8_t numBits);
+	uint16_t getCode(uint8_t numBits);
 };
 
 #endif
@@ -0,0 +1,154 @@
+/* Raw - Another World Interpreter
+ * Copyright (C) 2004 Gregory Montoir
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include <map>
+#include <mutex>
+#include <string>
+#include "bundle.h"
+#include "resource.h"
+#include "file.h"
+
+// Defined by a linked in bundle source, if any
+extern "C" {
+	extern const uint8_t quickerNEORAWBundleData[] __attribute__((weak));
+	extern const uint32_t quickerNEORAWBundleSize __attribute__((weak));
+}
+
+static const uint8_t BUNDLE_MAGIC[4] = { 'A', 'W', 'B', 'D' };
+
+bool ResourceBundle::parse(const uint8_t *data, uint32_t size) {
+	if (size < HEADER_SIZE || memcmp(data, BUNDLE_MAGIC, sizeof(BUNDLE_MAGIC)) != 0)
+		return false;
+
+	uint16_t version = READ_BE_UINT16(data + 4);
+	uint16_t numParts = READ_BE_UINT16(data + 6);
+	memListSize = READ_BE_UINT32(data + 8);
+	if (version != VERSION || numParts != GAME_NUM_PARTS)
+		return false;
+
+	const uint32_t partsSize = GAME_NUM_PARTS * 4 * 2;
+	if (memListSize > size - HEADER_SIZE || partsSize > size - HEADER_SIZE - memListSize)
+		return false;
+
+	const uint8_t *p = data + HEADER_SIZE;
+	memList = p;
+	p += memListSize;
+
+	for (int i = 0; i < GAME_NUM_PARTS; ++i) {
+		for (int j = 0; j < 4; ++j) {
+			memListParts[i][j] = READ_BE_UINT16(p);
+			p += 2;
+		}
+	}
+
+	// The cache is checked against the bundled memlist, its checksum is trusted
+	MemEntry entries[ResourceCache::MAX_ENTRIES];
+	uint16_t numEntries = 0;
+	while ((uint32_t)(numEntries + 1) * MEMENTRY_SIZE <= memListSize && numEntries < ResourceCache::MAX_ENTRIES) {
+		Resource::readMemEntry(memList + numEntries * MEMENTRY_SIZE, &entries[numEntries]);
+		if (entries[numEntries].state == MEMENTRY_STATE_END_OF_MEMLIST)
+			break;
+		++numEntries;
+	}
+
+	const uint32_t cacheSize = size - (p - data);
+	if (cacheSize < ResourceCache::HEADER_SIZE)
+		return false;
+	uint64_t checksum = ((uint64_t)READ_BE_UINT32(p + 8) << 32) | READ_BE_UINT32(p + 12);
+	return cache.parse(p, cacheSize, entries, numEntries, checksum);
+}
+
+uint8_t *ResourceBundle::build(const char *dataDir, uint32_t *size, int numThreads) {
+	File f(false, true);
+	if (!f.open("memlist.bin", dataDir))
+		error("ResourceBundle::build() unable to open 'memlist.bin' file");
+	uint32_t memListSize = f.size();
+	const uint8_t *memListData = f.map(memListSize);
+
+	Resource res(0, dataDir);
+	res.readEntries();
+
+	ResourceCache c;
+	c.build(dataDir, res._memList, res._numMemList, ResourceCache::computeChecksum(dataDir, res._memList, res._numMemList), numThreads);
+
+	*size = HEADER_SIZE + memListSize + GAME_NUM_PARTS * 4 * 2 + c._imageSize;
+	uint8_t *data = (uint8_t *)malloc(*size);
+	uint8_t *p = data;
+
+	memcpy(p, BUNDLE_MAGIC, sizeof(BUNDLE_MAGIC));
+	p[4] = VERSION >> 8; p[5] = VERSION & 0xFF;
+	p[6] = GAME_NUM_PARTS >> 8; p[7] = GAME_NUM_PARTS & 0xFF;
+	p[8] = memListSize >> 24; p[9] = (memListSize >> 16) & 0xFF; p[10] = (memListSize >> 8) & 0xFF; p[11] = memListSize & 0xFF;
+	p += HEADER_SIZE;
+
+	memcpy(p, memListData, memListSize);
+	p += memListSize;
+
+	for (int i = 0; i < GAME_NUM_PARTS; ++i) {
+		for (int j = 0; j < 4; ++j) {
+			*p++ = ::memListParts[i][j] >> 8;
+			*p++ = ::memListParts[i][j] & 0xFF;
+		}
+	}
+
+	memcpy(p, c._image, c._imageSize);
+	free(c._image);
+	return data;
+}
+
+const ResourceBundle *ResourceBundle::open(const char *path) {
+	static std::map<std::string, ResourceBundle *> bundles;
+	static std::mutex bundlesMutex;
+
+	std::lock_guard<std::mutex> lock(bundlesMutex);
+	auto it = bundles.find(path);
+	if (it != bundles.end())
+		return it->second;
+
+	char dir[512], name[256];
+	if (!splitPath(path, dir, sizeof(dir), name, sizeof(name)))
+		error("ResourceBundle::open() path too long '%s'", path);
+	File f(false, true);
+	if (!f.open(name, dir))
+		error("ResourceBundle::open() unable to open '%s'", path);
+	uint32_t size = f.size();
+	const uint8_t *data = f.map(size);
+
+	ResourceBundle *bundle = new ResourceBundle();
+	if (!data || !bundle->parse(data, size))
+		error("ResourceBundle::open() invalid bundle '%s'", path);
+	bundles[path] = bundle;
+	return bundle;
+}
+
+static const ResourceBundle *parseLinkedBundle() {
+	if (&quickerNEORAWBundleSize == 0)
+		return 0;
+	ResourceBundle *bundle = new ResourceBundle();
+	if (!bundle->parse(quickerNEORAWBundleData, quickerNEORAWBundleSize))
+		error("ResourceBundle::getLinked() invalid linked bundle");
+	return bundle;
+}
+
+/*
+	Returns the bundle linked into the executable, or NULL if there is none.
+*/
+const ResourceBundle *ResourceBundle::getLinked() {
+	static const ResourceBundle *bundle = parseLinkedBundle();
+	return bundle;
+}
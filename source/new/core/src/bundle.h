@@ -0,0 +1,60 @@
+/* Raw - Another World Interpreter
+ * Copyright (C) 2004 Gregory Montoir
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef __BUNDLE_H__
+#define __BUNDLE_H__
+
+#include "intern.h"
+#include "parts.h"
+#include "rescache.h"
+
+/*
+	All the game data the resource layer needs, in a single blob: a Resource
+	using it never opens memlist.bin nor the bank files.
+
+	  header       : 'AWBD', version (16), number of parts (16), memlist size (32)
+	  memlist      : memlist.bin, as is
+	  memListParts : number of parts x 4 x 16 bits (see parts.cpp)
+	  cache        : all the entries unpacked, as a resource cache image (see rescache.h)
+
+	All values are big endian. Bundles are made by the bundler tool, either as a
+	file (mapped when opened) or as a source file to link in, which defines the
+	quickerNEORAWBundleData / quickerNEORAWBundleSize symbols.
+*/
+struct ResourceBundle {
+	enum {
+		VERSION = 1,
+		HEADER_SIZE = 12
+	};
+
+	const uint8_t *memList;
+	uint32_t memListSize;
+	uint16_t memListParts[GAME_NUM_PARTS][4];
+	ResourceCache cache;
+
+	bool parse(const uint8_t *data, uint32_t size);
+
+	// Returns a malloc'ed bundle of the game data in 'dataDir'
+	static uint8_t *build(const char *dataDir, uint32_t *size, int numThreads);
+
+	// Bundles are shared by all the instances of the process and never freed
+	static const ResourceBundle *open(const char *path);
+	static const ResourceBundle *getLinked();
+};
+
+#endif
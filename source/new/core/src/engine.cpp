@@ -64,9 +64,11 @@ void Engine::init() {
 
 	vm.init();
 
-	mixer.init();
+	mixer._offline = _offlineAudio;
+	player._musicClock = _musicClock;
+	vm._musicClock = _musicClock;
 
-	player.init();
+	mixer.init();
 
 	uint16_t part = GAME_PART1;  // This game part is the protection screen
 #ifdef BYPASS_PROTECTION
@@ -113,6 +115,33 @@ void Engine::processInput() {
 	// }
 }
 
+/*
+	Offline audio rendering. The frame just run lasts vm.getFrameDuration(),
+	which is how much audio it gets. The music rows due within that time are
+	played at their place in the frame, between the mixed runs of samples.
+*/
+uint32_t Engine::getFrameAudioSamples() {
+	return (uint32_t)((uint64_t)vm.getFrameDuration() * sys->getOutputSampleRate() / 1000);
+}
+
+// Mixes the frame audio into buf (getFrameAudioSamples() unsigned 8-bit samples). Returns the samples written
+uint32_t Engine::mixFrameAudio(int8_t *buf) {
+	uint32_t frameMs = vm.getFrameDuration();
+	uint32_t rate = sys->getOutputSampleRate();
+	uint32_t ms = 0, samples = 0;
+	while (ms < frameMs) {
+		uint32_t step = MIN(player.getTimeToNextEvent(), frameMs - ms);
+		ms += step;
+		uint32_t end = (uint32_t)((uint64_t)ms * rate / 1000);
+		if (end > samples) {
+			mixer.mix(buf + samples, end - samples);
+			samples = end;
+		}
+		player.advanceClock(step);
+	}
+	return samples;
+}
+
 void Engine::makeGameStateName(uint8_t slot, char *buf) {
 	sprintf(buf, "raw.s%02d", slot);
 }
@@ -124,9 +153,13 @@ size_t Engine::saveGameState(uint8_t* buffer) {
 		{
 			res.saveOrLoad(s);
 			video.saveOrLoad(s);
-			player.saveOrLoad(s);
+			if (_musicClock == false) player.saveOrLoad(s);
 			mixer.saveOrLoad(s);
 		}
+		// With the music clock, the player drives the scripts and is always saved. It comes last, as
+		// loading it prepares the instruments in the resources loaded before (or already loaded, without
+		// the non-VM state: if the module is not among them, the music stops)
+		if (_musicClock == true) player.saveOrLoad(s);
 		return s._bytesCount;
 }
 
@@ -138,7 +171,8 @@ void Engine::loadGameState(uint8_t* buffer) {
 			{
 	 		res.saveOrLoad(s);
 				video.saveOrLoad(s);
-				player.saveOrLoad(s);
+				if (_musicClock == false) player.saveOrLoad(s);
 				mixer.saveOrLoad(s);
 			}
+			if (_musicClock == true) player.saveOrLoad(s);
 }
@@ -43,6 +43,12 @@ struct Engine {
 	uint8_t _stateSlot;
 	bool _storeNonVMState = true;
 
+	// Offline audio: set before init(), no audio device nor timer is used (see mixFrameAudio)
+	bool _offlineAudio = false;
+
+	// Music clock: set before init(), see SfxPlayer::_musicClock
+	bool _musicClock = false;
+
 	Engine(System *stub, const char *dataDir, const char *saveDir);
 	~Engine();
 
@@ -50,6 +56,9 @@ struct Engine {
 	void init();
 	void finish();
 	void processInput();
+
+	uint32_t getFrameAudioSamples();
+	uint32_t mixFrameAudio(int8_t *buf);
 	
 	void makeGameStateName(uint8_t slot, char *buf);
 	size_t saveGameState(uint8_t* buffer);
@@ -16,6 +16,13 @@
  * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
  */
 
+#include <map>
+#include <mutex>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "file.h"
 
 
@@ -27,7 +34,9 @@ struct File_impl {
 	virtual void close() = 0;
 	virtual void seek(int32_t off) = 0;
 	virtual void read(void *ptr, uint32_t size) = 0;
+	virtual const uint8_t *map(uint32_t size) = 0;
 	virtual void write(void *ptr, uint32_t size) = 0;
+	virtual uint32_t size() = 0;
 };
 
 struct stdFile : File_impl {
@@ -57,6 +66,19 @@ struct stdFile : File_impl {
 			}
 		}
 	}
+	const uint8_t *map(uint32_t size) {
+		return 0;
+	}
+	uint32_t size() {
+		uint32_t sz = 0;
+		if (_fp) {
+			long pos = ftell(_fp);
+			fseek(_fp, 0, SEEK_END);
+			sz = ftell(_fp);
+			fseek(_fp, pos, SEEK_SET);
+		}
+		return sz;
+	}
 	void write(void *ptr, uint32_t size) {
 		if (_fp) {
 			uint32_t r = fwrite(ptr, 1, size, _fp);
@@ -67,8 +89,110 @@ struct stdFile : File_impl {
 	}
 };
 
-File::File(bool gzipped) {
+/*
+	Read-only access to a file mapped in memory. Every file is mapped only once
+	per process, the first time it is opened, and that mapping is then shared by
+	all File objects (and all emulator instances/threads) until the process exits.
+	Failed opens are remembered too, so retrying a path does not hit the disk again.
+*/
+struct mmapFile : File_impl {
+	struct Mapping {
+		bool found;
+		const uint8_t *data;
+		uint32_t size;
+	};
+
+	static std::map<std::string, Mapping> _mappings;
+	static std::mutex _mappingsMutex;
+
+	const Mapping *_mapping;
+	uint32_t _pos;
+
+	mmapFile() : _mapping(0), _pos(0) {}
+
+	static Mapping createMapping(const char *path) {
+		Mapping m = { false, 0, 0 };
+		int fd = ::open(path, O_RDONLY);
+		if (fd < 0) {
+			return m;
+		}
+		struct stat st;
+		if (fstat(fd, &st) == 0) {
+			m.found = true;
+			m.size = st.st_size;
+			if (m.size > 0) {
+				void *data = mmap(0, m.size, PROT_READ, MAP_PRIVATE, fd, 0);
+				if (data != MAP_FAILED) {
+					m.data = (const uint8_t *)data;
+				} else {
+					m.found = false;
+				}
+			}
+		}
+		::close(fd);
+		return m;
+	}
+
+	bool open(const char *path, const char *mode) {
+		_ioErr = false;
+		_mapping = 0;
+		_pos = 0;
+		if (mode[0] != 'r' || strchr(mode, '+')) {
+			return false;
+		}
+		std::lock_guard<std::mutex> lock(_mappingsMutex);
+		auto it = _mappings.find(path);
+		if (it == _mappings.end()) {
+			it = _mappings.emplace(path, createMapping(path)).first;
+		}
+		if (!it->second.found) {
+			return false;
+		}
+		_mapping = &it->second;
+		return true;
+	}
+	void close() {
+		_mapping = 0;
+	}
+	void seek(int32_t off) {
+		if (_mapping) {
+			_pos = off;
+		}
+	}
+	void read(void *ptr, uint32_t size) {
+		if (_mapping) {
+			const uint8_t *p = map(size);
+			if (p) {
+				memcpy(ptr, p, size);
+			}
+		}
+	}
+	const uint8_t *map(uint32_t size) {
+		if (!_mapping || _pos > _mapping->size || size > _mapping->size - _pos) {
+			_ioErr = true;
+			return 0;
+		}
+		const uint8_t *p = _mapping->data + _pos;
+		_pos += size;
+		return p;
+	}
+	void write(void *ptr, uint32_t size) {
+		_ioErr = true;
+	}
+	uint32_t size() {
+		return _mapping ? _mapping->size : 0;
+	}
+};
+
+std::map<std::string, mmapFile::Mapping> mmapFile::_mappings;
+std::mutex mmapFile::_mappingsMutex;
+
+File::File(bool gzipped, bool mapped) {
+	if (mapped) {
+		_impl = new mmapFile;
+	} else {
 		_impl = new stdFile;
+	}
 }
 
 File::~File() {
@@ -79,7 +203,8 @@ File::~File() {
 bool File::open(const char *filename, const char *directory, const char *mode) {	
 	_impl->close();
 	char buf[512];
-	sprintf(buf, "%s/%s", directory, filename);
+	if (snprintf(buf, sizeof(buf), "%s/%s", directory, filename) >= (int)sizeof(buf))
+		return false;
 	char *p = buf + strlen(directory) + 1;
 	string_lower(p);
 	bool opened = _impl->open(buf, mode);
@@ -90,6 +215,11 @@ bool File::open(const char *filename, const char *directory, const char *mode) {
 	return opened;
 }
 
+bool File::openPath(const char *path, const char *mode) {
+	_impl->close();
+	return _impl->open(path, mode);
+}
+
 void File::close() {
 	_impl->close();
 }
@@ -106,6 +236,14 @@ void File::read(void *ptr, uint32_t size) {
 	_impl->read(ptr, size);
 }
 
+const uint8_t *File::map(uint32_t size) {
+	return _impl->map(size);
+}
+
+uint32_t File::size() {
+	return _impl->size();
+}
+
 uint8_t File::readByte() {
 	uint8_t b;
 	read(&b, 1);
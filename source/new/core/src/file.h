@@ -26,14 +26,20 @@ struct File_impl;
 struct File {
 	File_impl *_impl;
 
-	File(bool gzipped = false);
+	// A mapped file is read-only and shared process-wide (see mmapFile)
+	File(bool gzipped = false, bool mapped = false);
 	virtual ~File();
 
 	bool open(const char *filename, const char *directory, const char *mode="rb");
+	// Opens 'path' as given, without changing the case of the file name
+	bool openPath(const char *path, const char *mode="rb");
 	void close();
 	bool ioErr() const;
 	void seek(int32_t off);
 	void read(void *ptr, uint32_t size);
+	// Returns the next 'size' bytes in place (mapped files only, NULL otherwise)
+	const uint8_t *map(uint32_t size);
+	uint32_t size();
 	uint8_t readByte();
 	uint16_t readUint16BE();
 	uint32_t readUint32BE();
@@ -139,9 +139,8 @@ int main(int argc, char *argv[]) {
    =======
 	   Mixing is done on software.
 
-	   Since the virtal machine and SDL are running simultaneously in two different threads:
-	   Any read or write to an elements of the sound channels MUST be synchronized with a 
-	   mutex.
+	   There is no audio thread: the sound channels are played and mixed by the virtual
+	   machine thread, one frame at a time (see Engine::mixFrameAudio), so no mutex is needed.
 
    Endianess:
    ==========
@@ -20,8 +20,14 @@
 #include "serializer.h"
 #include "sys.h"
 
+#if defined(__SSE2__)
+	#include <emmintrin.h>
+#endif
 
-static int8_t addclamp(int a, int b) {
+// Samples are mixed in blocks, accumulated as 16 bits and clamped to 8 bits after every channel
+#define MIX_BLOCK_SIZE 512
+
+static inline int16_t addclamp(int a, int b) {
 	int add = a + b;
 	if (add < -128) {
 		add = -128;
@@ -29,7 +35,7 @@ static int8_t addclamp(int a, int b) {
 	else if (add > 127) {
 		add = 127;
 	}
-	return (int8_t)add;
+	return (int16_t)add;
 }
 
 Mixer::Mixer(System *stub) 
@@ -38,115 +44,212 @@ Mixer::Mixer(System *stub)
 
 void Mixer::init() {
 	memset(_channels, 0, sizeof(_channels));
-	_mutex = sys->createMutex();
-	sys->startAudio(Mixer::mixCallback, this);
+	if (!_offline) {
+		sys->startAudio(Mixer::mixCallback, this);
+	}
 }
 
 void Mixer::free() {
 	stopAll();
-	sys->stopAudio();
-	sys->destroyMutex(_mutex);
+	if (!_offline) {
+		sys->stopAudio();
+	}
 }
 
 void Mixer::playChannel(uint8_t channel, const MixerChunk *mc, uint16_t freq, uint8_t volume) {
 	debug(DBG_SND, "Mixer::playChannel(%d, %d, %d)", channel, freq, volume);
 	assert(channel < AUDIO_NUM_CHANNELS);
-
-	// The mutex is acquired in the constructor
-	MutexStack(sys, _mutex);
 	MixerChannel *ch = &_channels[channel];
 	ch->active = true;
 	ch->volume = volume;
 	ch->chunk = *mc;
 	ch->chunkPos = 0;
 	ch->chunkInc = (freq << 8) / sys->getOutputSampleRate();
-
-	//At the end of the scope the MutexStack destructor is called and the mutex is released. 
 }
 
 void Mixer::stopChannel(uint8_t channel) {
 	debug(DBG_SND, "Mixer::stopChannel(%d)", channel);
 	assert(channel < AUDIO_NUM_CHANNELS);
-	MutexStack(sys, _mutex);	
 	_channels[channel].active = false;
 }
 
 void Mixer::setChannelVolume(uint8_t channel, uint8_t volume) {
 	debug(DBG_SND, "Mixer::setChannelVolume(%d, %d)", channel, volume);
 	assert(channel < AUDIO_NUM_CHANNELS);
-	MutexStack(sys, _mutex);
 	_channels[channel].volume = volume;
 }
 
 void Mixer::stopAll() {
 	debug(DBG_SND, "Mixer::stopAll()");
-	MutexStack(sys, _mutex);
 	for (uint8_t i = 0; i < AUDIO_NUM_CHANNELS; ++i) {
 		_channels[i].active = false;		
 	}
 }
 
-// This is SDL callback. Called in order to populate the buf with len bytes.  
-// The mixer iterates through all active channels and combine all sounds.
+/*
+	One sample, exactly as the original mixer computes it. This is where the
+	channel loops back (to loopPos as an 8.8 position, as it always did) or
+	stops. Returns false once the channel has stopped.
+*/
+static bool mixSample(MixerChannel *ch, int16_t *out) {
+	uint16_t p1, p2;
+	uint16_t ilc = (ch->chunkPos & 0xFF);
+	p1 = ch->chunkPos >> 8;
+	ch->chunkPos += ch->chunkInc;
 
-// Since there is no way to know when SDL will ask for a buffer fill, we need
-// to synchronize with a mutex so the channels remain stable during the execution
-// of this method.
-void Mixer::mix(int8_t *buf, int len) {
-	int8_t *pBuf;
+	if (ch->chunk.loopLen != 0) {
+		if (p1 == ch->chunk.loopPos + ch->chunk.loopLen - 1) {
+			debug(DBG_SND, "Looping sample");
+			ch->chunkPos = p2 = ch->chunk.loopPos;
+		} else {
+			p2 = p1 + 1;
+		}
+	} else {
+		if (p1 == ch->chunk.len - 1) {
+			debug(DBG_SND, "Stopping sample");
+			ch->active = false;
+			return false;
+		} else {
+			p2 = p1 + 1;
+		}
+	}
+	// interpolate
+	int8_t b1 = *(int8_t *)(ch->chunk.data + p1);
+	int8_t b2 = *(int8_t *)(ch->chunk.data + p2);
+	int8_t b = (int8_t)((b1 * (0xFF - ilc) + b2 * ilc) >> 8);
 
-	MutexStack(sys, _mutex);
+	// set volume and clamp
+	*out = addclamp(*out, (int)b * ch->volume / 0x40);  //0x40=64
+	return true;
+}
 
-	//Clear the buffer since nothing garanty we are receiving clean memory.
-	memset(buf, 0, len);
+/*
+	Number of samples the channel plays from its current position before the
+	first one at or past the byte where it loops or stops. They can all be
+	mixed without any check. Once past that byte (the original mixer only
+	tests for it exactly, so fast channels can skip it), -1.
+*/
+static int getRunLength(const MixerChannel *ch) {
+	int boundary = (ch->chunk.loopLen != 0) ? ch->chunk.loopPos + ch->chunk.loopLen - 1 : ch->chunk.len - 1;
+	uint32_t inc = ch->chunkInc;
+	if (boundary < 0 || boundary > 0xFFFF || (int)(ch->chunkPos >> 8) > boundary) {
+		return -1;
+	}
+	uint32_t end = (uint32_t)boundary << 8;
+	if (ch->chunkPos >= end) {
+		return 0;
+	}
+	if (inc == 0) {
+		return 0x7FFFFFFF;
+	}
+	uint32_t n = (end - ch->chunkPos + inc - 1) / inc;
+	return (n > 0x7FFFFFFF) ? 0x7FFFFFFF : (int)n;
+}
 
-	for (uint8_t i = 0; i < AUDIO_NUM_CHANNELS; ++i) {
-		MixerChannel *ch = &_channels[i];
-		if (!ch->active) 
-			continue;
-
-		pBuf = buf;
-		for (int j = 0; j < len; ++j, ++pBuf) {
-
-			uint16_t p1, p2;
-			uint16_t ilc = (ch->chunkPos & 0xFF);
-			p1 = ch->chunkPos >> 8;
-			ch->chunkPos += ch->chunkInc;
-
-			if (ch->chunk.loopLen != 0) {
-				if (p1 == ch->chunk.loopPos + ch->chunk.loopLen - 1) {
-					debug(DBG_SND, "Looping sample on channel %d", i);
-					ch->chunkPos = p2 = ch->chunk.loopPos;
-				} else {
-					p2 = p1 + 1;
-				}
-			} else {
-				if (p1 == ch->chunk.len - 1) {
-					debug(DBG_SND, "Stopping sample on channel %d", i);
-					ch->active = false;
-					break;
-				} else {
-					p2 = p1 + 1;
-				}
-			}
-			// interpolate
-			int8_t b1 = *(int8_t *)(ch->chunk.data + p1);
-			int8_t b2 = *(int8_t *)(ch->chunk.data + p2);
-			int8_t b = (int8_t)((b1 * (0xFF - ilc) + b2 * ilc) >> 8);
+// Mixes n samples away from any boundary: the next sample is always the one after
+static void mixRun(MixerChannel *ch, int16_t *out, int n) {
+	const uint8_t *data = ch->chunk.data;
+	uint32_t pos = ch->chunkPos;
+	const uint32_t inc = ch->chunkInc;
+	const int volume = ch->volume;
+	int j = 0;
+#if defined(__SSE2__)
+	// Samples are fetched one at a time, interpolation, volume and clamping are done 8 at a time.
+	// Every intermediate value fits in 16 bits: |b1 * (0xFF - ilc) + b2 * ilc| and |b * volume| <= 128 * 255
+	const __m128i vol = _mm_set1_epi16(volume);
+	const __m128i ff = _mm_set1_epi16(0xFF);
+	const __m128i minSample = _mm_set1_epi16(-128);
+	const __m128i maxSample = _mm_set1_epi16(127);
+	// The interpolation weights only depend on the low bits of the positions, which 16-bit lanes keep
+	const __m128i steps = _mm_mullo_epi16(_mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7), _mm_set1_epi16(inc));
+	for (; j + 8 <= n; j += 8) {
+		__m128i b1 = _mm_setzero_si128(), b2 = _mm_setzero_si128();
+#define FETCH(k) { const uint32_t p = (pos + k * inc) >> 8; b1 = _mm_insert_epi16(b1, (int8_t)data[p], k); b2 = _mm_insert_epi16(b2, (int8_t)data[p + 1], k); }
+		FETCH(0) FETCH(1) FETCH(2) FETCH(3) FETCH(4) FETCH(5) FETCH(6) FETCH(7)
+#undef FETCH
+		const __m128i w2 = _mm_and_si128(_mm_add_epi16(_mm_set1_epi16(pos), steps), ff);
+		const __m128i w1 = _mm_sub_epi16(ff, w2);
+		pos += 8 * inc;
+		__m128i b = _mm_add_epi16(_mm_mullo_epi16(b1, w1), _mm_mullo_epi16(b2, w2));
+		b = _mm_srai_epi16(b, 8);
+		// b * volume / 64, rounded towards zero
+		__m128i m = _mm_mullo_epi16(b, vol);
+		m = _mm_srai_epi16(_mm_add_epi16(m, _mm_and_si128(_mm_srai_epi16(m, 15), _mm_set1_epi16(63))), 6);
+		__m128i o = _mm_add_epi16(_mm_loadu_si128((const __m128i *)(out + j)), m);
+		o = _mm_min_epi16(_mm_max_epi16(o, minSample), maxSample);
+		_mm_storeu_si128((__m128i *)(out + j), o);
+	}
+#endif
+	for (; j < n; ++j) {
+		const uint32_t p = pos >> 8;
+		const int ilc = pos & 0xFF;
+		const int b = ((int8_t)data[p] * (0xFF - ilc) + (int8_t)data[p + 1] * ilc) >> 8;
+		out[j] = addclamp(out[j], b * volume / 0x40);
+		pos += inc;
+	}
+	ch->chunkPos = pos;
+}
 
-			// set volume and clamp
-			*pBuf = addclamp(*pBuf, (int)b * ch->volume / 0x40);  //0x40=64
+static void mixChannel(MixerChannel *ch, int16_t *out, int len) {
+	int j = 0;
+	while (j < len) {
+		int run = getRunLength(ch);
+		if (run > 0) {
+			run = MIN(run, len - j);
+			mixRun(ch, out + j, run);
+			j += run;
+		} else {
+			if (!mixSample(ch, out + j)) {
+				return;
+			}
+			++j;
 		}
-		
 	}
+}
+
+/*
+	Fills buf with len unsigned 8-bit samples. Channels are only changed by the
+	emulation thread, which is also the one mixing them offline (there is no
+	audio device thread), so no lock is taken. Each channel is mixed from a
+	snapshot, written back once done.
+
+	Every channel is added to the previous ones with clamping, in order. This
+	is the original mixer output, sample for sample, mixed in runs between the
+	points where channels loop or stop.
+*/
+void Mixer::mix(int8_t *buf, int len) {
+	MixerChannel channels[AUDIO_NUM_CHANNELS];
+	memcpy(channels, _channels, sizeof(channels));
+
+	int16_t acc[MIX_BLOCK_SIZE];
+	for (int offset = 0; offset < len; offset += MIX_BLOCK_SIZE) {
+		const int n = MIN(MIX_BLOCK_SIZE, len - offset);
+		memset(acc, 0, n * sizeof(int16_t));
+
+		for (uint8_t i = 0; i < AUDIO_NUM_CHANNELS; ++i) {
+			if (channels[i].active) {
+				mixChannel(&channels[i], acc, n);
+			}
+		}
 
-	// Convert signed 8-bit PCM to unsigned 8-bit PCM. The
-	// current version of SDL hangs when using signed 8-bit
-	// PCM in combination with the PulseAudio driver.
-	pBuf = buf;
-	for (int j = 0; j < len; ++j, ++pBuf) {
-		*(uint8_t *)pBuf = (*pBuf + 128);
+		// Convert signed 8-bit PCM to unsigned 8-bit PCM. The
+		// current version of SDL hangs when using signed 8-bit
+		// PCM in combination with the PulseAudio driver.
+		uint8_t *dst = (uint8_t *)buf + offset;
+		int j = 0;
+#if defined(__SSE2__)
+		const __m128i bias = _mm_set1_epi8((char)0x80);
+		for (; j + 16 <= n; j += 16) {
+			__m128i s = _mm_packs_epi16(_mm_loadu_si128((const __m128i *)(acc + j)), _mm_loadu_si128((const __m128i *)(acc + j + 8)));
+			_mm_storeu_si128((__m128i *)(dst + j), _mm_xor_si128(s, bias));
+		}
+#endif
+		for (; j < n; ++j) {
+			dst[j] = (uint8_t)(acc[j] + 128);
+		}
 	}
+
+	memcpy(_channels, channels, sizeof(channels));
 }
 
 void Mixer::mixCallback(void *param, uint8_t *buf, int len) {
@@ -154,7 +257,6 @@ void Mixer::mixCallback(void *param, uint8_t *buf, int len) {
 }
 
 void Mixer::saveOrLoad(Serializer &ser) {
-	sys->lockMutex(_mutex);
 	for (int i = 0; i < AUDIO_NUM_CHANNELS; ++i) {
 		MixerChannel *ch = &_channels[i];
 		Serializer::Entry entries[] = {
@@ -170,5 +272,4 @@ void Mixer::saveOrLoad(Serializer &ser) {
 		};
 		ser.saveOrLoadEntries(entries);
 	}
-	sys->unlockMutex(_mutex);
 };
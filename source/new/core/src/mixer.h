@@ -44,14 +44,14 @@ struct System;
 struct Mixer {
 
 
-	void *_mutex;
 	System *sys;
 
-	// Since the virtal machine and SDL are running simultaneously in two different threads
-	// any read or write to an elements of the sound channels MUST be synchronized with a 
-	// mutex.
+	// Only accessed from the emulation thread, which mixes them too (see mix)
 	MixerChannel _channels[AUDIO_NUM_CHANNELS];
 
+	// Offline mode: no audio device is opened, samples are only produced by explicit mix() calls
+	bool _offline = false;
+
 	Mixer(System *stub);
 	void init();
 	void free();
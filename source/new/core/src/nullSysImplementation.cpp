@@ -0,0 +1,171 @@
+/* Raw - Another World Interpreter
+ * Copyright (C) 2004 Gregory Montoir
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include "sys.h"
+#include "util.h"
+
+/*
+	Headless System implementation. Nothing is ever displayed or played: the
+	framebuffer is unpacked into a plain 8-bit indexed buffer and the palette
+	is kept locally so both can still be queried (e.g. by the playback tool).
+*/
+struct NullSystem : System {
+
+	enum {
+		SCREEN_W = 320,
+		SCREEN_H = 200,
+		SOUND_SAMPLE_RATE = 22050
+	};
+
+	// Same layout as SDL_Color, so palette dumps are interchangeable with SDLStub
+	struct Color {
+		uint8_t r, g, b, a;
+	};
+
+	uint8_t _pixels[SCREEN_W * SCREEN_H];
+	Color _palette[NUM_COLORS];
+
+	virtual ~NullSystem() {}
+	virtual void init(const char *title);
+	virtual void destroy();
+	virtual void setPalette(const uint8_t *buf);
+	virtual void updateDisplay(const uint8_t *src);
+	virtual void updateDisplayUnpacked(const uint8_t *src);
+	virtual void processEvents();
+	virtual void sleep(uint32_t duration);
+	virtual uint32_t getTimeStamp();
+	virtual void startAudio(AudioCallback callback, void *param);
+	virtual void stopAudio();
+	virtual uint32_t getOutputSampleRate();
+	virtual int addTimer(uint32_t delay, TimerCallback callback, void *param);
+	virtual void removeTimer(int timerId);
+	virtual void *createMutex();
+	virtual void destroyMutex(void *mutex);
+	virtual void lockMutex(void *mutex);
+	virtual void unlockMutex(void *mutex);
+	virtual bool isHeadless();
+	virtual uint8_t* getPixelsPtr();
+	virtual size_t getPixelsSize();
+	virtual void updateRenderer();
+	virtual void applyPalette();
+	virtual uint8_t* getPalettePtr();
+	virtual size_t getPaletteSize();
+};
+
+void NullSystem::init(const char *title) {
+	memset(&input, 0, sizeof(input));
+}
+
+void NullSystem::destroy() {
+}
+
+void NullSystem::setPalette(const uint8_t *p) {
+	// The incoming palette is in 565 format.
+	for (int i = 0; i < NUM_COLORS; ++i) {
+		uint8_t c1 = *(p + 0);
+		uint8_t c2 = *(p + 1);
+		_palette[i].r = (((c1 & 0x0F) << 2) | ((c1 & 0x0F) >> 2)) << 2; // r
+		_palette[i].g = (((c2 & 0xF0) >> 2) | ((c2 & 0xF0) >> 6)) << 2; // g
+		_palette[i].b = (((c2 & 0x0F) >> 2) | ((c2 & 0x0F) << 2)) << 2; // b
+		_palette[i].a = 0xFF;
+		p += 2;
+	}
+}
+
+void NullSystem::applyPalette() {
+}
+
+uint8_t* NullSystem::getPalettePtr() {
+	return (uint8_t*)_palette;
+}
+
+size_t NullSystem::getPaletteSize() {
+	return sizeof(_palette);
+}
+
+uint8_t* NullSystem::getPixelsPtr() {
+	return _pixels;
+}
+
+size_t NullSystem::getPixelsSize() {
+	return sizeof(_pixels);
+}
+
+void NullSystem::updateDisplay(const uint8_t *src) {
+	uint8_t *p = _pixels;
+
+	// One byte gives us two palette indices
+	for (int i = 0; i < SCREEN_W * SCREEN_H / 2; ++i) {
+		p[i * 2 + 0] = src[i] >> 4;
+		p[i * 2 + 1] = src[i] & 0xF;
+	}
+}
+
+void NullSystem::updateDisplayUnpacked(const uint8_t *src) {
+	memcpy(_pixels, src, SCREEN_W * SCREEN_H);
+}
+
+void NullSystem::updateRenderer() {
+}
+
+void NullSystem::processEvents() {
+}
+
+void NullSystem::sleep(uint32_t duration) {
+}
+
+uint32_t NullSystem::getTimeStamp() {
+	return 0;
+}
+
+void NullSystem::startAudio(AudioCallback callback, void *param) {
+}
+
+void NullSystem::stopAudio() {
+}
+
+uint32_t NullSystem::getOutputSampleRate() {
+	return SOUND_SAMPLE_RATE;
+}
+
+int NullSystem::addTimer(uint32_t delay, TimerCallback callback, void *param) {
+	return 0;
+}
+
+void NullSystem::removeTimer(int timerId) {
+}
+
+void *NullSystem::createMutex() {
+	return nullptr;
+}
+
+void NullSystem::destroyMutex(void *mutex) {
+}
+
+void NullSystem::lockMutex(void *mutex) {
+}
+
+void NullSystem::unlockMutex(void *mutex) {
+}
+
+bool NullSystem::isHeadless() {
+	return true;
+}
+
+thread_local NullSystem sysImplementation;
+thread_local System *stub = &sysImplementation;
@@ -0,0 +1,122 @@
+/* Raw - Another World Interpreter
+ * Copyright (C) 2004 Gregory Montoir
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef __PLANAR_H__
+#define __PLANAR_H__
+
+#include <stdint.h>
+
+#if defined(__SSE2__)
+	#include <emmintrin.h>
+#endif
+
+/*
+	Planar to chunky, for the bitmaps given to Video::copyPage(): 4 planes of
+	8000 bytes, 8 pixels per byte. Pixel i of a byte takes bit 7 - i of every
+	plane, the first plane giving the lowest bit of the color.
+
+	Pixels are written in pairs, two per byte, or with UNPACKED (VIDEO_8BPP
+	pages) one per byte. Video uses the fastest version available, the others
+	are kept to check it against (tests/planarToChunky.cpp).
+*/
+
+#define PLANAR_PLANE_SIZE 8000
+
+// Reference: one byte of each plane (8 pixels), one bit at a time
+template <bool UNPACKED>
+static inline void planarToChunkyScalar(const uint8_t *src, uint8_t *dst) {
+	uint8_t p[] = {
+		src[PLANAR_PLANE_SIZE * 3],
+		src[PLANAR_PLANE_SIZE * 2],
+		src[PLANAR_PLANE_SIZE * 1],
+		src[PLANAR_PLANE_SIZE * 0]
+	};
+	for (int j = 0; j < 4; ++j) {
+		uint8_t acc = 0;
+		for (int i = 0; i < 8; ++i) {
+			acc <<= 1;
+			acc |= (p[i & 3] & 0x80) ? 1 : 0;
+			p[i & 3] <<= 1;
+		}
+		if (UNPACKED) {
+			dst[j * 2 + 0] = acc >> 4;
+			dst[j * 2 + 1] = acc & 0xF;
+		} else {
+			dst[j] = acc;
+		}
+	}
+}
+
+// Bit 7 - i of b in byte i: the shifted copies of b do not overlap, so nothing carries
+static inline uint64_t planarSpreadBits(uint8_t b) {
+	return ((b * 0x8040201008040201ULL) & 0x8080808080808080ULL) >> 7;
+}
+
+// One byte of each plane (8 pixels), all bits of a byte at once
+template <bool UNPACKED>
+static inline void planarToChunky(const uint8_t *src, uint8_t *dst) {
+	uint64_t pixels = planarSpreadBits(src[0]) | planarSpreadBits(src[PLANAR_PLANE_SIZE]) << 1 | planarSpreadBits(src[PLANAR_PLANE_SIZE * 2]) << 2 | planarSpreadBits(src[PLANAR_PLANE_SIZE * 3]) << 3;
+	if (UNPACKED) {
+		for (int i = 0; i < 8; ++i)
+			dst[i] = pixels >> (i * 8);
+	} else {
+		// Pairs of pixels into bytes, then the even bytes together
+		pixels = ((pixels << 4) | (pixels >> 8)) & 0x00FF00FF00FF00FFULL;
+		pixels = (pixels | (pixels >> 8)) & 0x0000FFFF0000FFFFULL;
+		pixels = pixels | (pixels >> 16);
+		for (int i = 0; i < 4; ++i)
+			dst[i] = pixels >> (i * 8);
+	}
+}
+
+#if defined(__SSE2__)
+// 16 bytes of each plane (128 pixels): every byte is repeated 8 times and tested against the 8 bit masks
+template <bool UNPACKED>
+static inline void planarToChunky16(const uint8_t *src, uint8_t *dst) {
+	const __m128i bits = _mm_set_epi8(1, 2, 4, 8, 16, 32, 64, (char)128, 1, 2, 4, 8, 16, 32, 64, (char)128);
+	__m128i pixels[8];
+	for (int k = 0; k < 8; ++k)
+		pixels[k] = _mm_setzero_si128();
+	for (int plane = 0; plane < 4; ++plane) {
+		const __m128i v = _mm_loadu_si128((const __m128i *)(src + plane * PLANAR_PLANE_SIZE));
+		const __m128i color = _mm_set1_epi8(1 << plane);
+		const __m128i lo = _mm_unpacklo_epi8(v, v);
+		const __m128i hi = _mm_unpackhi_epi8(v, v);
+		const __m128i quads[4] = { _mm_unpacklo_epi16(lo, lo), _mm_unpackhi_epi16(lo, lo), _mm_unpacklo_epi16(hi, hi), _mm_unpackhi_epi16(hi, hi) };
+		for (int k = 0; k < 4; ++k) {
+			const __m128i a = _mm_unpacklo_epi32(quads[k], quads[k]);
+			const __m128i b = _mm_unpackhi_epi32(quads[k], quads[k]);
+			pixels[k * 2 + 0] = _mm_or_si128(pixels[k * 2 + 0], _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(a, bits), bits), color));
+			pixels[k * 2 + 1] = _mm_or_si128(pixels[k * 2 + 1], _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(b, bits), bits), color));
+		}
+	}
+	if (UNPACKED) {
+		for (int k = 0; k < 8; ++k)
+			_mm_storeu_si128((__m128i *)(dst + k * 16), pixels[k]);
+	} else {
+		const __m128i low = _mm_set1_epi16(0xFF);
+		for (int k = 0; k < 8; k += 2) {
+			const __m128i a = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(pixels[k + 0], low), 4), _mm_srli_epi16(pixels[k + 0], 8));
+			const __m128i b = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(pixels[k + 1], low), 4), _mm_srli_epi16(pixels[k + 1], 8));
+			_mm_storeu_si128((__m128i *)(dst + k * 8), _mm_packus_epi16(a, b));
+		}
+	}
+}
+#endif
+
+#endif
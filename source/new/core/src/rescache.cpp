@@ -0,0 +1,239 @@
+/* Raw - Another World Interpreter
+ * Copyright (C) 2004 Gregory Montoir
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <unistd.h>
+#include "rescache.h"
+#include "resource.h"
+#include "bank.h"
+#include "file.h"
+
+static const uint8_t CACHE_MAGIC[4] = { 'A', 'W', 'R', 'C' };
+
+static void writeBE16(uint8_t *p, uint16_t n) {
+	p[0] = n >> 8;
+	p[1] = n & 0xFF;
+}
+
+static void writeBE32(uint8_t *p, uint32_t n) {
+	writeBE16(p + 0, n >> 16);
+	writeBE16(p + 2, n & 0xFFFF);
+}
+
+// FNV-1a, 64 bits
+static uint64_t hashBytes(uint64_t h, const uint8_t *p, uint32_t len) {
+	while (len--) {
+		h ^= *p++;
+		h *= 0x100000001B3ULL;
+	}
+	return h;
+}
+
+ResourceCache::ResourceCache()
+	: numEntries(0), checksum(0), _image(0), _imageSize(0) {
+	memset(entries, 0, sizeof(entries));
+	memset(sizes, 0, sizeof(sizes));
+}
+
+bool ResourceCache::parse(const uint8_t *image, uint32_t size, const MemEntry *memList, uint16_t numMemList, uint64_t expectedChecksum) {
+	if (size < HEADER_SIZE || memcmp(image, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0)
+		return false;
+
+	uint16_t version = READ_BE_UINT16(image + 4);
+	uint16_t n = READ_BE_UINT16(image + 6);
+	uint64_t ck = ((uint64_t)READ_BE_UINT32(image + 8) << 32) | READ_BE_UINT32(image + 12);
+	if (version != VERSION || n != numMemList || n > MAX_ENTRIES || ck != expectedChecksum)
+		return false;
+
+	if (size < (uint32_t)(HEADER_SIZE + n * INDEX_ENTRY_SIZE))
+		return false;
+
+	const uint8_t *p = image + HEADER_SIZE;
+	for (uint16_t i = 0; i < n; ++i) {
+		uint32_t off = READ_BE_UINT32(p); p += 4;
+		uint32_t sz = READ_BE_UINT32(p); p += 4;
+		if (off == 0) {
+			entries[i] = 0;
+			sizes[i] = 0;
+			continue;
+		}
+		if (sz != memList[i].size || off > size || sz > size - off)
+			return false;
+		entries[i] = image + off;
+		sizes[i] = sz;
+	}
+
+	numEntries = n;
+	checksum = ck;
+	return true;
+}
+
+void ResourceCache::build(const char *dataDir, const MemEntry *memList, uint16_t numMemList, uint64_t sourceChecksum, int numThreads) {
+	assert(numMemList <= MAX_ENTRIES);
+
+	// Data offsets are known up front, so entries can be unpacked in any order
+	std::vector<uint32_t> offsets(numMemList, 0);
+	uint32_t offset = HEADER_SIZE + numMemList * INDEX_ENTRY_SIZE;
+	for (uint16_t i = 0; i < numMemList; ++i) {
+		if (memList[i].bankId != 0 && memList[i].size != 0) {
+			offsets[i] = offset;
+			offset += memList[i].size;
+		}
+	}
+
+	_imageSize = offset;
+	_image = (uint8_t *)malloc(_imageSize);
+
+	memcpy(_image, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	writeBE16(_image + 4, VERSION);
+	writeBE16(_image + 6, numMemList);
+	writeBE32(_image + 8, sourceChecksum >> 32);
+	writeBE32(_image + 12, sourceChecksum & 0xFFFFFFFF);
+
+	std::atomic<int> nextEntry(0);
+	auto unpackEntries = [&]() {
+		Bank bk(dataDir);
+		int i;
+		while ((i = nextEntry++) < numMemList) {
+			uint8_t *idx = _image + HEADER_SIZE + i * INDEX_ENTRY_SIZE;
+			writeBE32(idx + 0, offsets[i]);
+			writeBE32(idx + 4, offsets[i] ? memList[i].size : 0);
+			if (offsets[i] && !bk.read(&memList[i], _image + offsets[i])) {
+				error("ResourceCache::build() unable to unpack entry %d", i);
+			}
+		}
+	};
+
+	if (numThreads <= 1) {
+		unpackEntries();
+	} else {
+		std::vector<std::thread> workers;
+		for (int t = 0; t < numThreads; ++t) {
+			workers.emplace_back(unpackEntries);
+		}
+		for (auto &w : workers) {
+			w.join();
+		}
+	}
+
+	parse(_image, _imageSize, memList, numMemList, sourceChecksum);
+}
+
+/*
+	The image is written to a temporary file first and then renamed, so other
+	processes never map a partially written cache. Unlike game data files, the
+	cache path is used as given, without changing its case.
+*/
+bool ResourceCache::save(const char *path) const {
+	char tmpPath[1024];
+	if (snprintf(tmpPath, sizeof(tmpPath), "%s.%d.tmp", path, (int)getpid()) >= (int)sizeof(tmpPath))
+		return false;
+
+	FILE *fp = fopen(tmpPath, "wb");
+	if (!fp)
+		return false;
+	bool ok = (fwrite(_image, 1, _imageSize, fp) == _imageSize);
+	ok = (fclose(fp) == 0) && ok;
+
+	if (ok) {
+		ok = (rename(tmpPath, path) == 0);
+	}
+	if (!ok) {
+		remove(tmpPath);
+	}
+	return ok;
+}
+
+uint64_t ResourceCache::computeChecksum(const char *dataDir, const MemEntry *memList, uint16_t numMemList) {
+	uint64_t h = 0xCBF29CE484222325ULL;
+	for (uint16_t i = 0; i < numMemList; ++i) {
+		const MemEntry *me = &memList[i];
+		uint8_t desc[12];
+		desc[0] = me->type;
+		desc[1] = me->bankId;
+		writeBE32(desc + 2, me->bankOffset);
+		writeBE16(desc + 6, me->packedSize);
+		writeBE16(desc + 8, me->size);
+		writeBE16(desc + 10, i);
+		h = hashBytes(h, desc, sizeof(desc));
+
+		if (me->bankId == 0)
+			continue;
+
+		char bankName[10];
+		sprintf(bankName, "bank%02x", me->bankId);
+		File f(false, true);
+		if (!f.open(bankName, dataDir))
+			error("ResourceCache::computeChecksum() unable to open '%s'", bankName);
+		f.seek(me->bankOffset);
+		const uint8_t *src = f.map(me->packedSize);
+		if (!src)
+			error("ResourceCache::computeChecksum() unable to read entry %d from '%s'", i, bankName);
+		h = hashBytes(h, src, me->packedSize);
+	}
+	return h;
+}
+
+/*
+	Returns the cache stored at 'path' for the given game data. It is mapped from
+	disk when present and valid. Otherwise it is built (unpacking every entry) and
+	written back so the next runs can map it. Without a path the cache is only
+	built in memory.
+*/
+const ResourceCache *ResourceCache::open(const char *path, const char *dataDir, const MemEntry *memList, uint16_t numMemList, int numThreads) {
+	static std::map<std::pair<std::string, std::string>, ResourceCache *> caches;
+	static std::mutex cachesMutex;
+
+	uint64_t ck = computeChecksum(dataDir, memList, numMemList);
+	const std::pair<std::string, std::string> key(path ? path : "", dataDir);
+
+	std::lock_guard<std::mutex> lock(cachesMutex);
+	auto it = caches.find(key);
+	if (it != caches.end() && it->second->checksum == ck)
+		return it->second;
+
+	// Caches may still be in use by other instances, they are never freed
+	ResourceCache *cache = new ResourceCache();
+
+	if (path) {
+		File f(false, true);
+		if (f.openPath(path)) {
+			uint32_t size = f.size();
+			const uint8_t *image = f.map(size);
+			if (image && cache->parse(image, size, memList, numMemList, ck)) {
+				debug(DBG_RES, "ResourceCache::open() mapped '%s'", path);
+				caches[key] = cache;
+				return cache;
+			}
+		}
+	}
+
+	debug(DBG_RES, "ResourceCache::open() building '%s' with %d threads", path ? path : dataDir, numThreads);
+	cache->build(dataDir, memList, numMemList, ck, numThreads);
+	if (path && !cache->save(path)) {
+		warning("ResourceCache::open() unable to write '%s'", path);
+	}
+	caches[key] = cache;
+	return cache;
+}
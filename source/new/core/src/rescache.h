@@ -0,0 +1,74 @@
+/* Raw - Another World Interpreter
+ * Copyright (C) 2004 Gregory Montoir
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+
+#ifndef __RESCACHE_H__
+#define __RESCACHE_H__
+
+#include "intern.h"
+
+struct MemEntry;
+
+/*
+	Every memlist entry, already unpacked. Loading a resource from the cache is a
+	plain copy into the resource memory block instead of a bank read + unpack.
+
+	A cache is immutable once built and is shared (by file path and data dir)
+	between all the emulator instances of the process. It can also be kept in
+	memory only (eager preload, no file). On disk it is a single file, memory
+	mapped when loaded:
+
+	  header : 'AWRC', version (16), numEntries (16), checksum (64)
+	  index  : numEntries x { offset (32), size (32) }, offset 0 if not cached
+	  data   : the unpacked entries
+
+	All values are big endian. The checksum covers memlist.bin and the packed
+	bank data, so a cache built from different game files is never used.
+*/
+struct ResourceCache {
+	enum {
+		VERSION = 1,
+		MAX_ENTRIES = 150,
+		HEADER_SIZE = 16,
+		INDEX_ENTRY_SIZE = 8
+	};
+
+	uint16_t numEntries;
+	uint64_t checksum;
+	const uint8_t *entries[MAX_ENTRIES];
+	uint32_t sizes[MAX_ENTRIES];
+
+	// Image in the file format, when built by this process (otherwise it is mapped)
+	uint8_t *_image;
+	uint32_t _imageSize;
+
+	ResourceCache();
+
+	const uint8_t *getEntry(uint16_t num) const {
+		return (num < numEntries) ? entries[num] : 0;
+	}
+
+	bool parse(const uint8_t *image, uint32_t size, const MemEntry *memList, uint16_t numMemList, uint64_t expectedChecksum);
+	void build(const char *dataDir, const MemEntry *memList, uint16_t numMemList, uint64_t sourceChecksum, int numThreads);
+	bool save(const char *path) const;
+
+	static uint64_t computeChecksum(const char *dataDir, const MemEntry *memList, uint16_t numMemList);
+	// 'path' can be NULL for a memory only cache. Entries are unpacked on 'numThreads' threads
+	static const ResourceCache *open(const char *path, const char *dataDir, const MemEntry *memList, uint16_t numMemList, int numThreads);
+};
+
+#endif
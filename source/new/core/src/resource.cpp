@@ -23,19 +23,52 @@
 #include "video.h"
 #include "util.h"
 #include "parts.h"
+#include "rescache.h"
+#include "bundle.h"
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
 
 Resource::Resource(Video *vid, const char *dataDir) 
-	: video(vid), _dataDir(dataDir), currentPartId(0),requestedNextPart(0) {
+	: video(vid), _dataDir(dataDir), currentPartId(0),requestedNextPart(0), _cacheFile(0), _preloadThreads(0), _cache(0), _bundle(0), _memListParts(memListParts) {
+	memset(_partSnapshots, 0, sizeof(_partSnapshots));
+	memset(&_counters, 0, sizeof(_counters));
+}
+
+static uint64_t getTimeNs() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
 }
 
 void Resource::readBank(const MemEntry *me, uint8_t *dstBuf) {
 	uint16_t n = me - _memList;
 	debug(DBG_BANK, "Resource::readBank(%d)", n);
+	++_counters.readBankCalls;
+
+	if (_cache) {
+		const uint8_t *data = _cache->getEntry(n);
+		if (data) {
+			memcpy(dstBuf, data, me->size);
+			++_counters.cacheHits;
+			return;
+		}
+	}
+
+	if (_bundle) {
+		error("Resource::readBank() entry %d is not in the resource bundle", n);
+	}
 
+	uint64_t startNs = getTimeNs();
 	Bank bk(_dataDir);
 	if (!bk.read(me, dstBuf)) {
 		error("Resource::readBank() unable to unpack entry %d\n", n);
 	}
+	_counters.unpackNs += getTimeNs() - startNs;
+	_counters.bytesRead += me->packedSize;
+	if (me->packedSize != me->size) {
+		_counters.bytesUnpacked += me->size;
+	}
 
 }
 
@@ -55,24 +88,47 @@ static const char *resTypeToString(unsigned int type)
 	return resTypes[type];
 }
 
+void Resource::readMemEntry(const uint8_t *p, MemEntry *me) {
+	me->state = p[0];
+	me->type = p[1];
+	me->bufPtr = 0;
+	me->unk4 = READ_BE_UINT16(p + 4);
+	me->rankNum = p[6];
+	me->bankId = p[7];
+	me->bankOffset = READ_BE_UINT32(p + 8);
+	me->unkC = READ_BE_UINT16(p + 12);
+	me->packedSize = READ_BE_UINT16(p + 14);
+	me->unk10 = READ_BE_UINT16(p + 16);
+	me->size = READ_BE_UINT16(p + 18);
+}
+
 #define RES_SIZE 0
 #define RES_COMPRESSED 1
-int resourceSizeStats[7][2];
 #define STATS_TOTAL_SIZE 6
-int resourceUnitStats[7][2];
 
 /*
 	Read all entries from memlist.bin. Do not load anything in memory,
 	this is just a fast way to access the data later based on their id.
 */
 void Resource::readEntries() {	
-	File f;
+	File f(false, true);
 	int resourceCounter = 0;
+	// Local, so instances can be initialized on several threads at once
+	int resourceSizeStats[7][2];
+	int resourceUnitStats[7][2];
 	
-
-	if (!f.open("memlist.bin", _dataDir)) {
-		error("Resource::readEntries() unable to open 'memlist.bin' file\n");
-		//Error will exit() no need to return or do anything else.
+	const uint8_t *p;
+	uint32_t size;
+	if (_bundle) {
+		p = _bundle->memList;
+		size = _bundle->memListSize;
+	} else {
+		if (!f.open("memlist.bin", _dataDir)) {
+			error("Resource::readEntries() unable to open 'memlist.bin' file\n");
+			//Error will exit() no need to return or do anything else.
+		}
+		size = f.size();
+		p = f.map(size);
 	}
 
 	//Prepare stats array
@@ -83,17 +139,11 @@ void Resource::readEntries() {
 	MemEntry *memEntry = _memList;
 	while (1) {
 		assert(_numMemList < ARRAYSIZE(_memList));
-		memEntry->state = f.readByte();
-		memEntry->type = f.readByte();
-		memEntry->bufPtr = 0; f.readUint16BE();
-		memEntry->unk4 = f.readUint16BE();
-		memEntry->rankNum = f.readByte();
-		memEntry->bankId = f.readByte();
-		memEntry->bankOffset = f.readUint32BE();
-		memEntry->unkC = f.readUint16BE();
-		memEntry->packedSize = f.readUint16BE();
-		memEntry->unk10 = f.readUint16BE();
-		memEntry->size = f.readUint16BE();
+		if ((uint32_t)(_numMemList + 1) * MEMENTRY_SIZE > size) {
+			error("Resource::readEntries() truncated memlist");
+		}
+		readMemEntry(p, memEntry);
+		p += MEMENTRY_SIZE;
 
     if (memEntry->state == MEMENTRY_STATE_END_OF_MEMLIST) {
       break;
@@ -156,6 +206,12 @@ void Resource::readEntries() {
 	for(int i=0 ; i < 6 ; i++)
 		debug(DBG_RES,"Total %-17s files: %3d",resTypeToString(i),resourceUnitStats[i][RES_SIZE]+resourceUnitStats[i][RES_COMPRESSED]);
 
+	if (_bundle) {
+		_cache = &_bundle->cache;
+		_memListParts = _bundle->memListParts;
+	} else if (_cacheFile || _preloadThreads > 0) {
+		_cache = ResourceCache::open(_cacheFile, _dataDir, _memList, _numMemList, _preloadThreads);
+	}
 }
 
 /*
@@ -284,26 +340,40 @@ void Resource::setupPart(uint16_t partId) {
 		error("Resource::setupPart() ec=0x%X invalid partId", partId);
 
 	uint16_t memListPartIndex = partId - GAME_PART_FIRST;
+	uint64_t startNs = getTimeNs();
+	++_counters.partSwitches;
+
+	uint8_t paletteIndex = _memListParts[memListPartIndex][MEMLIST_PART_PALETTE];
+	uint8_t codeIndex    = _memListParts[memListPartIndex][MEMLIST_PART_CODE];
+	uint8_t videoCinematicIndex  = _memListParts[memListPartIndex][MEMLIST_PART_POLY_CINEMATIC];
+	uint8_t video2Index  = _memListParts[memListPartIndex][MEMLIST_PART_VIDEO2];
 
-	uint8_t paletteIndex = memListParts[memListPartIndex][MEMLIST_PART_PALETTE];
-	uint8_t codeIndex    = memListParts[memListPartIndex][MEMLIST_PART_CODE];
-	uint8_t videoCinematicIndex  = memListParts[memListPartIndex][MEMLIST_PART_POLY_CINEMATIC];
-	uint8_t video2Index  = memListParts[memListPartIndex][MEMLIST_PART_VIDEO2];
+	// Deferred draw calls and cached vertices point to the current part data
+	video->rasterize();
+	video->invalidateVertexCache();
 
 	// Mark all resources as located on harddrive.
 	invalidateAll();
 
-	_memList[paletteIndex].state = MEMENTRY_STATE_LOAD_ME;
-	_memList[codeIndex].state = MEMENTRY_STATE_LOAD_ME;
-	_memList[videoCinematicIndex].state = MEMENTRY_STATE_LOAD_ME;
-
-	// This is probably a cinematic or a non interactive part of the game.
-	// Player and enemy polygons are not needed.
-	if (video2Index != MEMLIST_PART_NONE) 
-		_memList[video2Index].state = MEMENTRY_STATE_LOAD_ME;
-	
+	// A part already loaded once (by any instance) is restored with a single copy
+	const PartSnapshot *snapshot = findPartSnapshot(memListPartIndex);
+	if (snapshot) {
+		restorePartSnapshot(snapshot);
+		++_counters.partSnapshotHits;
+	} else {
+		_memList[paletteIndex].state = MEMENTRY_STATE_LOAD_ME;
+		_memList[codeIndex].state = MEMENTRY_STATE_LOAD_ME;
+		_memList[videoCinematicIndex].state = MEMENTRY_STATE_LOAD_ME;
+
+		// This is probably a cinematic or a non interactive part of the game.
+		// Player and enemy polygons are not needed.
+		if (video2Index != MEMLIST_PART_NONE) 
+			_memList[video2Index].state = MEMENTRY_STATE_LOAD_ME;
+		
 
-	loadMarkedAsNeeded();
+		loadMarkedAsNeeded();
+		savePartSnapshot(memListPartIndex);
+	}
 
 	segPalettes = _memList[paletteIndex].bufPtr;
 	segBytecode     = _memList[codeIndex].bufPtr;
@@ -332,10 +402,82 @@ void Resource::setupPart(uint16_t partId) {
 
 	// _scriptCurPtr is changed in this->load();
 	_scriptBakPtr = _scriptCurPtr;	
+
+	_counters.partSwitchNs += getTimeNs() - startNs;
+}
+
+static std::map<std::pair<std::string, uint16_t>, const PartSnapshot *> _partSnapshotsRegistry;
+static std::mutex _partSnapshotsMutex;
+
+// Snapshots only depend on where the game data comes from
+static std::string getDataSourceKey(const Resource *res) {
+	if (res->_bundle) {
+		char key[32];
+		sprintf(key, "bundle:%p", (const void *)res->_bundle);
+		return key;
+	}
+	return res->_dataDir;
+}
+
+const PartSnapshot *Resource::findPartSnapshot(uint16_t memListPartIndex) {
+	if (!_partSnapshots[memListPartIndex]) {
+		std::lock_guard<std::mutex> lock(_partSnapshotsMutex);
+		auto it = _partSnapshotsRegistry.find(std::make_pair(getDataSourceKey(this), memListPartIndex));
+		if (it != _partSnapshotsRegistry.end()) {
+			_partSnapshots[memListPartIndex] = it->second;
+		}
+	}
+	return _partSnapshots[memListPartIndex];
+}
+
+void Resource::restorePartSnapshot(const PartSnapshot *snapshot) {
+	memcpy(_memPtrStart, snapshot->data, snapshot->size);
+	for (uint8_t i = 0; i < snapshot->numEntries; ++i) {
+		MemEntry *me = &_memList[snapshot->entries[i]];
+		me->bufPtr = _memPtrStart + snapshot->offsets[i];
+		me->state = MEMENTRY_STATE_LOADED;
+	}
+	_scriptCurPtr = _memPtrStart + snapshot->size;
+}
+
+/*
+	Called right after the part resources were loaded: only them are marked as
+	loaded at this point.
+*/
+void Resource::savePartSnapshot(uint16_t memListPartIndex) {
+	PartSnapshot *snapshot = new PartSnapshot();
+	snapshot->numEntries = 0;
+	for (uint16_t i = 0; i < _numMemList; ++i) {
+		if (_memList[i].state == MEMENTRY_STATE_LOADED) {
+			assert(snapshot->numEntries < PartSnapshot::MAX_ENTRIES);
+			snapshot->entries[snapshot->numEntries] = i;
+			snapshot->offsets[snapshot->numEntries] = _memList[i].bufPtr - _memPtrStart;
+			++snapshot->numEntries;
+		}
+	}
+	snapshot->size = _scriptCurPtr - _memPtrStart;
+	snapshot->data = (uint8_t *)malloc(snapshot->size);
+	memcpy(snapshot->data, _memPtrStart, snapshot->size);
+
+	std::lock_guard<std::mutex> lock(_partSnapshotsMutex);
+	const PartSnapshot *&registered = _partSnapshotsRegistry[std::make_pair(getDataSourceKey(this), memListPartIndex)];
+	if (registered) {
+		// Another instance got there first, both are identical
+		free(snapshot->data);
+		delete snapshot;
+	} else {
+		registered = snapshot;
+	}
+	_partSnapshots[memListPartIndex] = registered;
 }
 
 void Resource::allocMemBlock() {
 	_memPtrStart = (uint8_t *)malloc(MEM_BLOCK_SIZE);
+
+	// Touching the whole block now places its pages on the NUMA node of the
+	// initializing thread (first touch), rather than wherever it is first used.
+	memset(_memPtrStart, 0, MEM_BLOCK_SIZE);
+
 	_scriptBakPtr = _scriptCurPtr = _memPtrStart;
 	_vidBakPtr = _vidCurPtr = _memPtrStart + MEM_BLOCK_SIZE - 0x800 * 16; //0x800 = 2048, so we have 32KB free for vidBack and vidCur
 	_useSegVideo2 = false;
@@ -393,6 +535,7 @@ void Resource::saveOrLoad(Serializer &ser) {
 		while (*p) {
 			MemEntry *me = &_memList[*p++];
 			readBank(me, q);
+			++_counters.stateLoadReads;
 			me->bufPtr = q;
 			me->state = MEMENTRY_STATE_LOADED;
 			q += me->size;
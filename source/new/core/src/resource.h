@@ -20,6 +20,7 @@
 #define __RESOURCE_H__
 
 #include "intern.h"
+#include "parts.h"
 
 
 #define MEMENTRY_STATE_END_OF_MEMLIST 0xFF
@@ -27,6 +28,9 @@
 #define MEMENTRY_STATE_LOADED 1
 #define MEMENTRY_STATE_LOAD_ME 2
 
+// Size of a memlist.bin record
+#define MEMENTRY_SIZE 20
+
 /*
     This is a directory entry. When the game starts, it loads memlist.bin and 
 	populate and array of MemEntry
@@ -56,8 +60,44 @@ struct MemEntry {
     See MEMENTRY_STATE_* #defines above.
 */
 
+/*
+	Resource I/O counters, accumulated since the Resource was created (or since
+	the host last cleared them).
+*/
+struct ResourceCounters {
+	uint64_t readBankCalls;
+	uint64_t cacheHits;        // readBank calls served by the resource cache
+	uint64_t bytesRead;        // Bytes read from the banks (packed size)
+	uint64_t bytesUnpacked;    // Bytes produced by Bank::unpack
+	uint64_t unpackNs;         // Time spent in Bank::read (copy or unpack)
+	uint64_t partSwitches;
+	uint64_t partSnapshotHits; // Part switches restored from a part snapshot
+	uint64_t partSwitchNs;
+	uint64_t stateLoadReads;   // Entries reloaded by savestate loads
+};
+
 struct Serializer;
 struct Video;
+struct ResourceCache;
+struct ResourceBundle;
+
+/*
+	Resource memory right after Resource::setupPart loaded a part: the bytes from
+	_memPtrStart up to _scriptCurPtr and the memlist entries loaded there. It only
+	depends on the game data, so snapshots are shared by all the instances of the
+	process (per data dir) and never freed.
+*/
+struct PartSnapshot {
+	enum {
+		MAX_ENTRIES = 4
+	};
+
+	uint32_t size;
+	uint8_t *data;
+	uint8_t numEntries;
+	uint8_t entries[MAX_ENTRIES];
+	uint32_t offsets[MAX_ENTRIES];
+};
 
 struct Resource {
 
@@ -94,8 +134,24 @@ struct Resource {
 	uint8_t *segCinematic;
 	uint8_t *_segVideo2;
 
+	// Optional pre-unpacked resource cache, see rescache.h. With _preloadThreads > 0
+	// and no cache file, every entry is unpacked eagerly into a memory only cache
+	const char *_cacheFile;
+	int _preloadThreads;
+	const ResourceCache *_cache;
+
+	// Optional single file replacing the game data (memlist, parts and unpacked
+	// resources), see bundle.h. Set before readEntries
+	const ResourceBundle *_bundle;
+	const uint16_t (*_memListParts)[4];
+
+	const PartSnapshot *_partSnapshots[GAME_NUM_PARTS];
+
+	ResourceCounters _counters;
+
 	Resource(Video *vid, const char *dataDir);
 	
+	static void readMemEntry(const uint8_t *p, MemEntry *me);
 	void readBank(const MemEntry *me, uint8_t *dstBuf);
 	void readEntries();
 	void loadMarkedAsNeeded();
@@ -103,6 +159,9 @@ struct Resource {
 	void invalidateRes();	
 	void loadPartsOrMemoryEntry(uint16_t num);
 	void setupPart(uint16_t ptrId);
+	const PartSnapshot *findPartSnapshot(uint16_t memListPartIndex);
+	void restorePartSnapshot(const PartSnapshot *snapshot);
+	void savePartSnapshot(uint16_t memListPartIndex);
 	void allocMemBlock();
 	void freeMemBlock();
 	
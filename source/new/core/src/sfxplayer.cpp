@@ -20,33 +20,24 @@
 #include "mixer.h"
 #include "resource.h"
 #include "serializer.h"
-#include "sys.h"
 
 
 SfxPlayer::SfxPlayer(Mixer *mix, Resource *res, System *stub)
-	: mixer(mix), res(res), sys(stub), _delay(0), _resNum(0) {
-}
-
-void SfxPlayer::init() {
-	_mutex = sys->createMutex();
+	: mixer(mix), res(res), sys(stub), _delay(0), _resNum(0), _clock(0) {
 }
 
 void SfxPlayer::free() {
 	stop();
-	sys->destroyMutex(_mutex);
 }
 
 void SfxPlayer::setEventsDelay(uint16_t delay) {
 	debug(DBG_SND, "SfxPlayer::setEventsDelay(%d)", delay);
-	MutexStack(sys, _mutex);
 	_delay = delay * 60 / 7050;
 }
 
 void SfxPlayer::loadSfxModule(uint16_t resNum, uint16_t delay, uint8_t pos) {
 
 	debug(DBG_SND, "SfxPlayer::loadSfxModule(0x%X, %d, %d)", resNum, delay, pos);
-	MutexStack(sys, _mutex);
-
 
 	MemEntry *me = &res->_memList[resNum];
 
@@ -95,25 +86,39 @@ void SfxPlayer::prepareInstruments(const uint8_t *p) {
 	}
 }
 
+// Whether the module and all its instruments are loaded, so that loadSfxModule() cannot fail
+bool SfxPlayer::isModuleLoaded(uint16_t resNum) const {
+	if (resNum >= res->_numMemList)
+		return false;
+	const MemEntry *me = &res->_memList[resNum];
+	if (me->state != MEMENTRY_STATE_LOADED || me->type != Resource::RT_MUSIC)
+		return false;
+	const uint8_t *p = me->bufPtr + 2;
+	for (int i = 0; i < 15; ++i, p += 4) {
+		uint16_t insNum = READ_BE_UINT16(p);
+		if (insNum == 0)
+			continue;
+		if (insNum >= res->_numMemList)
+			return false;
+		const MemEntry *ins = &res->_memList[insNum];
+		if (ins->state != MEMENTRY_STATE_LOADED || ins->type != Resource::RT_SOUND)
+			return false;
+	}
+	return true;
+}
+
 void SfxPlayer::start() {
 	debug(DBG_SND, "SfxPlayer::start()");
-	MutexStack(sys, _mutex);
 	_sfxMod.curPos = 0;
-	_timerId = sys->addTimer(_delay, eventsCallback, this);			
+	_clock = 0;
 }
 
 void SfxPlayer::stop() {
 	debug(DBG_SND, "SfxPlayer::stop()");
-	MutexStack(sys, _mutex);
-	if (_resNum != 0) {
-		_resNum = 0;
-		sys->removeTimer(_timerId);
-	}
+	_resNum = 0;
 }
 
 void SfxPlayer::handleEvents() {
-	return;
-	MutexStack(sys, _mutex);
 	uint8_t order = _sfxMod.orderTable[_sfxMod.curOrder];
 	const uint8_t *patternData = _sfxMod.data + _sfxMod.curPos + order * 1024;
 	for (uint8_t ch = 0; ch < 4; ++ch) {
@@ -127,7 +132,6 @@ void SfxPlayer::handleEvents() {
 		order = _sfxMod.curOrder + 1;
 		if (order == _sfxMod.numOrder) {
 			_resNum = 0;
-			sys->removeTimer(_timerId);
 			mixer->stopAll();
 		}
 		_sfxMod.curOrder = order;
@@ -181,7 +185,10 @@ void SfxPlayer::handlePattern(uint8_t channel, const uint8_t *data) {
 	}
 	if (pat.note_1 == 0xFFFD) {
 		debug(DBG_SND, "SfxPlayer::handlePattern() _scriptVars[0xF4] = 0x%X", pat.note_2);
-		*_markVar = pat.note_2;
+		// Without the music clock, rows are only played for audio: the scripts never see them
+		if (_musicClock) {
+			*_markVar = pat.note_2;
+		}
 	} else if (pat.note_1 != 0) {
 		if (pat.note_1 == 0xFFFE) {
 			mixer->stopChannel(channel);
@@ -201,14 +208,32 @@ void SfxPlayer::handlePattern(uint8_t channel, const uint8_t *data) {
 	}
 }
 
-uint32_t SfxPlayer::eventsCallback(uint32_t interval, void *param) {
-	SfxPlayer *p = (SfxPlayer *)param;
-	p->handleEvents();
-	return p->_delay;
+/*
+	Frame clock. Rows are due every _delay ms, the first one _delay ms after
+	start(), as the original timer did. A zero delay stops the events, as a
+	timer callback returning 0 did.
+*/
+uint32_t SfxPlayer::getTimeToNextEvent() const {
+	if (_resNum == 0 || _delay == 0) {
+		return 0xFFFFFFFF;
+	}
+	return (_clock < _delay) ? _delay - _clock : 0;
+}
+
+// Plays every row due within the next 'ms' ms
+void SfxPlayer::advanceClock(uint32_t ms) {
+	uint32_t next;
+	while ((next = getTimeToNextEvent()) <= ms) {
+		ms -= next;
+		_clock = 0;
+		handleEvents();
+	}
+	if (_resNum != 0) {
+		_clock += ms;
+	}
 }
 
 void SfxPlayer::saveOrLoad(Serializer &ser) {
-	sys->lockMutex(_mutex);
 	Serializer::Entry entries[] = {
 		SE_INT(&_delay, Serializer::SES_INT8, VER(2)),
 		SE_INT(&_resNum, Serializer::SES_INT16, VER(2)),
@@ -217,11 +242,36 @@ void SfxPlayer::saveOrLoad(Serializer &ser) {
 		SE_END()
 	};
 	ser.saveOrLoadEntries(entries);
-	sys->unlockMutex(_mutex);
+
+	// The music clock needs the exact time to the next row (the delay above only keeps 8 bits)
+	uint16_t delay = _delay;
+	uint32_t clock = 0;
+	if (_musicClock) {
+		Serializer::Entry clockEntries[] = {
+			SE_INT(&_delay, Serializer::SES_INT16, VER(2)),
+			SE_INT(&_clock, Serializer::SES_INT32, VER(2)),
+			SE_END()
+		};
+		ser.saveOrLoadEntries(clockEntries);
+		delay = _delay;
+		clock = _clock;
+	}
+
+	// The module is prepared from the resources loaded now. They are restored before, unless the
+	// non-VM state is not stored: then the state must come from an instance with the same resources
+	// loaded. If they are not, the music stops, the same way on every load
+	if (ser._mode == Serializer::SM_LOAD && _resNum != 0 && !isModuleLoaded(_resNum)) {
+		debug(DBG_SND, "SfxPlayer::saveOrLoad() module 0x%X not loaded, stopping", _resNum);
+		_resNum = 0;
+		memset(&_sfxMod, 0, sizeof(SfxModule));
+		_delay = 0;
+		_clock = 0;
+	}
 	if (ser._mode == Serializer::SM_LOAD && _resNum != 0) {
-		uint16_t delay = _delay;
+		uint16_t curPos = _sfxMod.curPos;
 		loadSfxModule(_resNum, 0, _sfxMod.curOrder);
+		_sfxMod.curPos = curPos;
 		_delay = delay;
-		_timerId = sys->addTimer(_delay, eventsCallback, this);
+		_clock = clock;
 	}
 }
@@ -57,26 +57,32 @@ struct SfxPlayer {
 	Resource *res;
 	System *sys;
 
-	void *_mutex;
-	int _timerId;
 	uint16_t _delay;
 	uint16_t _resNum;
 	SfxModule _sfxMod;
 	int16_t *_markVar;
 
+	// Rows are played as the frame clock advances (see advanceClock), there is no timer thread
+	uint32_t _clock; // ms elapsed since the last row
+
+	// Music clock: the VM frames drive the rows and their marks reach the scripts. The clock is then part
+	// of the game state. Otherwise, as in the reference core, rows are only played for offline audio
+	bool _musicClock = false;
+
 	SfxPlayer(Mixer *mix, Resource *res, System *stub);
-	void init();
 	void free();
 
 	void setEventsDelay(uint16_t delay);
 	void loadSfxModule(uint16_t resNum, uint16_t delay, uint8_t pos);
 	void prepareInstruments(const uint8_t *p);
+	bool isModuleLoaded(uint16_t resNum) const;
 	void start();
 	void stop();
 	void handleEvents();
 	void handlePattern(uint8_t channel, const uint8_t *patternData);
 
-	static uint32_t eventsCallback(uint32_t interval, void *param);
+	uint32_t getTimeToNextEvent() const;
+	void advanceClock(uint32_t ms);
 
 	void saveOrLoad(Serializer &ser);
 };
@@ -61,6 +61,8 @@ struct System {
 	virtual void updateRenderer() = 0;
 	virtual void setPalette(const uint8_t *buf) = 0;
 	virtual void updateDisplay(const uint8_t *buf) = 0;
+	// Same, from a page holding one pixel per byte (VIDEO_8BPP)
+	virtual void updateDisplayUnpacked(const uint8_t *buf) = 0;
 
 	virtual void applyPalette() = 0;
 	virtual uint8_t* getPalettePtr() = 0;
@@ -81,6 +83,9 @@ struct System {
 	virtual void destroyMutex(void *mutex) = 0;
 	virtual void lockMutex(void *mutex) = 0;
 	virtual void unlockMutex(void *mutex) = 0;
+
+	// Whether the system works without any window or device, so instances can run on several threads
+	virtual bool isHeadless() = 0;
 };
 
 struct MutexStack {
@@ -36,12 +36,15 @@ struct SDLStub : System {
 	SDL_Window * _window = nullptr;
 	SDL_Renderer * _renderer = nullptr;
 	uint8_t _scale = DEFAULT_SCALE;
+	// Last palette set, kept to re-upload it when the screen surface is re-created
+	SDL_Color _palette[NUM_COLORS] = {};
 
 	virtual ~SDLStub() {}
 	virtual void init(const char *title);
 	virtual void destroy();
 	virtual void setPalette(const uint8_t *buf);
 	virtual void updateDisplay(const uint8_t *src);
+	virtual void updateDisplayUnpacked(const uint8_t *src);
 	virtual void processEvents();
 	virtual void sleep(uint32_t duration);
 	virtual uint32_t getTimeStamp();
@@ -54,6 +57,7 @@ struct SDLStub : System {
 	virtual void destroyMutex(void *mutex);
 	virtual void lockMutex(void *mutex);
 	virtual void unlockMutex(void *mutex);
+	virtual bool isHeadless();
  virtual uint8_t* getPixelsPtr();
  virtual size_t getPixelsSize();
 	virtual void updateRenderer();
@@ -79,17 +83,16 @@ void SDLStub::destroy() {
 	SDL_Quit();
 }
 
-static SDL_Color palette[NUM_COLORS];
 void SDLStub::setPalette(const uint8_t *p) {
   // The incoming palette is in 565 format.
   for (int i = 0; i < NUM_COLORS; ++i)
   {
     uint8_t c1 = *(p + 0);
     uint8_t c2 = *(p + 1);
-    palette[i].r = (((c1 & 0x0F) << 2) | ((c1 & 0x0F) >> 2)) << 2; // r
-    palette[i].g = (((c2 & 0xF0) >> 2) | ((c2 & 0xF0) >> 6)) << 2; // g
-    palette[i].b = (((c2 & 0x0F) >> 2) | ((c2 & 0x0F) << 2)) << 2; // b
-    palette[i].a = 0xFF;
+    _palette[i].r = (((c1 & 0x0F) << 2) | ((c1 & 0x0F) >> 2)) << 2; // r
+    _palette[i].g = (((c2 & 0xF0) >> 2) | ((c2 & 0xF0) >> 6)) << 2; // g
+    _palette[i].b = (((c2 & 0x0F) >> 2) | ((c2 & 0x0F) << 2)) << 2; // b
+    _palette[i].a = 0xFF;
     p += 2;
   }
   applyPalette();
@@ -97,7 +100,7 @@ void SDLStub::setPalette(const uint8_t *p) {
 
 void SDLStub::applyPalette()
 {
-	SDL_SetPaletteColors(_screen->format->palette, palette, 0, NUM_COLORS);
+	SDL_SetPaletteColors(_screen->format->palette, _palette, 0, NUM_COLORS);
 }
 
 void SDLStub::prepareGfxMode() {
@@ -115,17 +118,17 @@ void SDLStub::prepareGfxMode() {
   // a palette is set by the VM.
   // To avoid this issue, we save the last palette locally and re-upload it each time. On game start-up this
   // is not requested.
-  SDL_SetPaletteColors(_screen->format->palette, palette, 0, NUM_COLORS);
+  SDL_SetPaletteColors(_screen->format->palette, _palette, 0, NUM_COLORS);
 }
 
 uint8_t* SDLStub::getPalettePtr()
 {
-  return (uint8_t*)palette;
+  return (uint8_t*)_palette;
 }
 
 size_t SDLStub::getPaletteSize()
 {
-  return sizeof(palette);
+  return sizeof(_palette);
 }
 
 uint8_t* SDLStub::getPixelsPtr()
@@ -155,6 +158,17 @@ void SDLStub::updateDisplay(const uint8_t *src) {
 	}
 }
 
+void SDLStub::updateDisplayUnpacked(const uint8_t *src) {
+	uint8_t* p = (uint8_t*)_screen->pixels;
+
+	//One byte per pixel, lines are copied as they are
+	for (int y = 0; y < SCREEN_H; ++y) {
+		memcpy(p, src, SCREEN_W);
+		p += _screen->pitch;
+		src += SCREEN_W;
+	}
+}
+
 void SDLStub::updateRenderer()
 {
 	 SDL_Texture* texture = SDL_CreateTextureFromSurface(_renderer, _screen);
@@ -304,6 +318,10 @@ void SDLStub::unlockMutex(void *mutex) {
 	// SDL_mutexV((SDL_mutex *)mutex);
 }
 
+bool SDLStub::isHeadless() {
+	return false;
+}
+
 
 
 void SDLStub::cleanupGfxMode() {
@@ -68,3 +68,19 @@ void string_upper(char *p) {
 		}
 	}
 }
+
+bool splitPath(const char *path, char *dir, size_t dirSize, char *name, size_t nameSize) {
+	const char *sep = strrchr(path, '/');
+	const char *file = sep ? sep + 1 : path;
+	size_t dirLen = sep ? (size_t)(sep - path) : 1;
+	if (dirLen >= dirSize || strlen(file) >= nameSize)
+		return false;
+	if (sep) {
+		memcpy(dir, path, dirLen);
+	} else {
+		dir[0] = '.';
+	}
+	dir[dirLen] = 0;
+	strcpy(name, file);
+	return true;
+}
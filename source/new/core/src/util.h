@@ -40,4 +40,8 @@ extern void warning(const char *msg, ...);
 extern void string_lower(char *p);
 extern void string_upper(char *p);
 
+// Splits 'path' into the directory and file name arguments expected by File::open.
+// Returns false if either part does not fit its buffer
+extern bool splitPath(const char *path, char *dir, size_t dirSize, char *name, size_t nameSize);
+
 #endif
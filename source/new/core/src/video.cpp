@@ -17,9 +17,193 @@
  */
 
 #include "video.h"
+#include "planar.h"
 #include "resource.h"
 #include "serializer.h"
 #include "sys.h"
+#include <vector>
+
+#if defined(__AVX2__)
+	#include <immintrin.h>
+#elif defined(__SSSE3__)
+	#include <tmmintrin.h>
+#elif defined(__SSE2__)
+	#include <emmintrin.h>
+#endif
+
+/*
+	The palette lookup of the RGBA observations needs SSSE3 (pshufb). Builds that
+	only assume SSE2, the x86-64 default, still compile it for SSSE3 and use it
+	when the cpu has it.
+*/
+#if defined(__SSSE3__)
+	#define OBSERVATION_SSSE3_TARGET
+#elif defined(__SSE2__) && defined(__GNUC__)
+	#include <tmmintrin.h>
+	#define OBSERVATION_SSSE3_TARGET __attribute__((target("ssse3")))
+	#define OBSERVATION_SSSE3_DISPATCH
+#endif
+
+
+/*
+	Pixel pairs: the operations defined on packed bytes (two pixels) go through
+	these, so they behave the same with one pixel per byte (VIDEO_8BPP). This
+	also keeps the quirks of colors above 15 spilling into the other pixel.
+*/
+#ifdef VIDEO_8BPP
+#define PAIR_SIZE 2
+static inline uint8_t loadPair(const uint8_t *p) {
+	return (p[0] << 4) | p[1];
+}
+static inline void storePair(uint8_t *p, uint8_t b) {
+	p[0] = b >> 4;
+	p[1] = b & 0xF;
+}
+#else
+#define PAIR_SIZE 1
+static inline uint8_t loadPair(const uint8_t *p) {
+	return *p;
+}
+static inline void storePair(uint8_t *p, uint8_t b) {
+	*p = b;
+}
+#endif
+
+/*
+	Span helpers for the bytes in the middle of a scanline (at most 320).
+	They use the widest stores available. The last store may overlap the
+	previous one: applying any of these operations twice gives the same result.
+*/
+static inline void fillSpan(uint8_t *p, uint8_t colb, uint16_t w) {
+#if defined(__AVX2__)
+	if (w >= 32) {
+		const __m256i c = _mm256_set1_epi8(colb);
+		uint16_t i = 0;
+		for (; i + 32 <= w; i += 32)
+			_mm256_storeu_si256((__m256i *)(p + i), c);
+		if (i < w)
+			_mm256_storeu_si256((__m256i *)(p + w - 32), c);
+		return;
+	}
+#endif
+#if defined(__SSE2__)
+	if (w >= 16) {
+		const __m128i c = _mm_set1_epi8(colb);
+		uint16_t i = 0;
+		for (; i + 16 <= w; i += 16)
+			_mm_storeu_si128((__m128i *)(p + i), c);
+		if (i < w)
+			_mm_storeu_si128((__m128i *)(p + w - 16), c);
+		return;
+	}
+#endif
+	if (w >= 8) {
+		const uint64_t c = 0x0101010101010101ULL * colb;
+		uint16_t i = 0;
+		for (; i + 8 <= w; i += 8)
+			memcpy(p + i, &c, 8);
+		if (i < w)
+			memcpy(p + w - 8, &c, 8);
+		return;
+	}
+	while (w--)
+		*p++ = colb;
+}
+
+static inline void copySpan(uint8_t *p, const uint8_t *q, uint16_t w) {
+#if defined(__AVX2__)
+	if (w >= 32) {
+		uint16_t i = 0;
+		for (; i + 32 <= w; i += 32)
+			_mm256_storeu_si256((__m256i *)(p + i), _mm256_loadu_si256((const __m256i *)(q + i)));
+		if (i < w)
+			_mm256_storeu_si256((__m256i *)(p + w - 32), _mm256_loadu_si256((const __m256i *)(q + w - 32)));
+		return;
+	}
+#endif
+#if defined(__SSE2__)
+	if (w >= 16) {
+		uint16_t i = 0;
+		for (; i + 16 <= w; i += 16)
+			_mm_storeu_si128((__m128i *)(p + i), _mm_loadu_si128((const __m128i *)(q + i)));
+		if (i < w)
+			_mm_storeu_si128((__m128i *)(p + w - 16), _mm_loadu_si128((const __m128i *)(q + w - 16)));
+		return;
+	}
+#endif
+	if (w >= 8) {
+		uint64_t c;
+		uint16_t i = 0;
+		for (; i + 8 <= w; i += 8) {
+			memcpy(&c, q + i, 8);
+			memcpy(p + i, &c, 8);
+		}
+		if (i < w) {
+			memcpy(&c, q + w - 8, 8);
+			memcpy(p + w - 8, &c, 8);
+		}
+		return;
+	}
+	while (w--)
+		*p++ = *q++;
+}
+
+// Sets the highest bit of the pixels: (*p & mask) | bits
+static inline void blendSpan(uint8_t *p, uint16_t w, uint8_t mask, uint8_t bits) {
+#if defined(__AVX2__)
+	if (w >= 32) {
+		const __m256i m = _mm256_set1_epi8(mask);
+		const __m256i b = _mm256_set1_epi8((char)bits);
+		uint16_t i = 0;
+		for (; i + 32 <= w; i += 32) {
+			__m256i *v = (__m256i *)(p + i);
+			_mm256_storeu_si256(v, _mm256_or_si256(_mm256_and_si256(_mm256_loadu_si256(v), m), b));
+		}
+		if (i < w) {
+			__m256i *v = (__m256i *)(p + w - 32);
+			_mm256_storeu_si256(v, _mm256_or_si256(_mm256_and_si256(_mm256_loadu_si256(v), m), b));
+		}
+		return;
+	}
+#endif
+#if defined(__SSE2__)
+	if (w >= 16) {
+		const __m128i m = _mm_set1_epi8(mask);
+		const __m128i b = _mm_set1_epi8((char)bits);
+		uint16_t i = 0;
+		for (; i + 16 <= w; i += 16) {
+			__m128i *v = (__m128i *)(p + i);
+			_mm_storeu_si128(v, _mm_or_si128(_mm_and_si128(_mm_loadu_si128(v), m), b));
+		}
+		if (i < w) {
+			__m128i *v = (__m128i *)(p + w - 16);
+			_mm_storeu_si128(v, _mm_or_si128(_mm_and_si128(_mm_loadu_si128(v), m), b));
+		}
+		return;
+	}
+#endif
+	if (w >= 8) {
+		const uint64_t m = 0x0101010101010101ULL * mask;
+		const uint64_t b = 0x0101010101010101ULL * bits;
+		uint64_t c;
+		uint16_t i = 0;
+		for (; i + 8 <= w; i += 8) {
+			memcpy(&c, p + i, 8);
+			c = (c & m) | b;
+			memcpy(p + i, &c, 8);
+		}
+		if (i < w) {
+			memcpy(&c, p + w - 8, 8);
+			c = (c & m) | b;
+			memcpy(p + w - 8, &c, 8);
+		}
+		return;
+	}
+	while (w--) {
+		*p = (*p & mask) | bits;
+		++p;
+	}
+}
 
 
 void Polygon::readVertices(const uint8_t *p, uint16_t zoom) {
@@ -42,6 +226,10 @@ Video::Video(Resource *resParameter, System *stub)
 
 void Video::init() {
 	paletteIdRequested = NO_PALETTE_CHANGE_REQUESTED;
+	memset(_paletteRGBA, 0, sizeof(_paletteRGBA));
+	memset(_paletteRGBAPairs, 0, sizeof(_paletteRGBAPairs));
+	memset(_paletteChannels, 0, sizeof(_paletteChannels));
+	invalidateVertexCache();
 
 	uint8_t* tmp = (uint8_t *)malloc(4 * VID_PAGE_SIZE);
 	memset(tmp,0,4 * VID_PAGE_SIZE);
@@ -50,6 +238,13 @@ void Video::init() {
     _pages[i] = tmp + i * VID_PAGE_SIZE;
 	}
 
+#ifdef VIDEO_8BPP
+	uint8_t *packed = (uint8_t *)malloc(4 * VID_PACKED_PAGE_SIZE);
+	for (int i = 0; i < 4; ++i) {
+		_packedPages[i] = packed + i * VID_PACKED_PAGE_SIZE;
+	}
+#endif
+
 	_curPagePtr3 = getPage(1);
 	_curPagePtr2 = getPage(2);
 
@@ -80,7 +275,18 @@ void Video::setDataBuffer(uint8_t *dataBuf, uint16_t offset) {
 
 	 This is a recursive function. */
 void Video::readAndDrawPolygon(uint8_t color, uint16_t zoom, const Point &pt) {
-if (_doRendering == false) return;
+	if (_doRendering == false) {
+		if (_deferRendering) {
+			DisplayCommand *dc = recordCommand(DisplayCommand::DC_POLYGON, getPageIndex(_curPagePtr1));
+			dc->data = _dataBuf;
+			dc->offset = _pData.pc - _dataBuf;
+			dc->color = color;
+			dc->zoom = zoom;
+			dc->x = pt.x;
+			dc->y = pt.y;
+		}
+		return;
+	}
 	uint8_t i = _pData.fetchByte();
 
 	//This is 
@@ -93,9 +299,7 @@ if (_doRendering == false) return;
 
 		// pc is misleading here since we are not reading bytecode but only
 		// vertices informations.
-		polygon.readVertices(_pData.pc, zoom);
-
-		fillPolygon(color, zoom, pt);
+		fillPolygon(getPolygon(_pData.pc, zoom), color, pt);
 
 
 
@@ -115,7 +319,28 @@ if (_doRendering == false) return;
 
 }
 
-void Video::fillPolygon(uint16_t color, uint16_t zoom, const Point &pt) {
+/*
+	Shapes are drawn again and again at the same zoom, so their scaled vertices
+	are kept. The vertex data address identifies a shape.
+*/
+const Polygon &Video::getPolygon(const uint8_t *p, uint16_t zoom) {
+	uint32_t index = (((uintptr_t)p >> 1) ^ (zoom * 7)) & (VERTEX_CACHE_SIZE - 1);
+	VertexCacheEntry *entry = &_vertexCache[index];
+	if (entry->src != p || entry->zoom != zoom) {
+		entry->polygon.readVertices(p, zoom);
+		entry->src = p;
+		entry->zoom = zoom;
+	}
+	return entry->polygon;
+}
+
+void Video::invalidateVertexCache() {
+	for (int i = 0; i < VERTEX_CACHE_SIZE; ++i) {
+		_vertexCache[i].src = 0;
+	}
+}
+
+void Video::fillPolygon(const Polygon &polygon, uint16_t color, const Point &pt) {
 if (_doRendering == false) return;
 	if (polygon.bbw == 0 && polygon.bbh == 1 && polygon.numPoints == 4) {
 		drawPoint(color, pt.x, pt.y);
@@ -133,9 +358,23 @@ if (_doRendering == false) return;
 
 	_hliney = y1;
 	
+	// One fully inlined scanline loop per draw mode
+	if (color < 0x10) {
+		fillPolygonLines<&Video::drawLineN>(polygon, color, x1);
+	} else if (color > 0x10) {
+		fillPolygonLines<&Video::drawLineP>(polygon, color, x1);
+	} else {
+		fillPolygonLines<&Video::drawLineBlend>(polygon, color, x1);
+	}
+}
+
+template <Video::drawLine DRAW_LINE>
+void Video::fillPolygonLines(const Polygon &polygon, uint16_t color, int16_t x1) {
+	int16_t x2;
 	uint16_t i, j;
+	uint8_t numPoints = polygon.numPoints;
 	i = 0;
-	j = polygon.numPoints - 1;
+	j = numPoints - 1;
 	
 	x2 = polygon.points[i].x + x1;
 	x1 = polygon.points[j].x + x1;
@@ -143,21 +382,12 @@ if (_doRendering == false) return;
 	++i;
 	--j;
 
-	drawLine drawFct;
-	if (color < 0x10) {
-		drawFct = &Video::drawLineN;
-	} else if (color > 0x10) {
-		drawFct = &Video::drawLineP;
-	} else {
-		drawFct = &Video::drawLineBlend;
-	}
-
 	uint32_t cpt1 = x1 << 16;
 	uint32_t cpt2 = x2 << 16;
 
 	while (1) {
-		polygon.numPoints -= 2;
-		if (polygon.numPoints == 0) {
+		numPoints -= 2;
+		if (numPoints == 0) {
 			break;
 		}
 		uint16_t h = 0;
@@ -181,7 +411,7 @@ if (_doRendering == false) return;
 					if (x1 <= 319 && x2 >= 0) {
 						if (x1 < 0) x1 = 0;
 						if (x2 > 319) x2 = 319;
-						(this->*drawFct)(x1, x2, color);
+						(this->*DRAW_LINE)(x1, x2, color);
 					}
 				}
 				cpt1 += step1;
@@ -191,11 +421,6 @@ if (_doRendering == false) return;
 			}
 		}
 	}
-
-
-
-
-
 }
 
 /*
@@ -241,41 +466,123 @@ if (_doRendering == false) return;
 	
 }
 
+// Only called by fillPolygon, which already checked _doRendering
 int32_t Video::calcStep(const Point &p1, const Point &p2, uint16_t &dy) {
-	if (_doRendering == false) return 0;
 	dy = p2.y - p1.y;
 	return (p2.x - p1.x) * _interpTable[dy] * 4;
 }
 
-void Video::drawString(uint8_t color, uint16_t x, uint16_t y, uint16_t stringId) {
-if (_doRendering == false) return;
-	const StrEntry *se = _stringsTableEng;
+/*
+	Text tables, built once and shared: a dense index of _stringsTableEng by
+	string id with the lines of every string (split at '\n'), and for every
+	font row (8 pixels), the pixels it sets in a page row. Colors above 15 spill into the high nibble of the pair, as
+	when the pixels were set one pair at a time.
+*/
+#ifdef VIDEO_8BPP
+typedef uint64_t GlyphRowBits;
+#else
+typedef uint32_t GlyphRowBits;
+#endif
+
+struct TextTables {
+	enum {
+		MAX_STRING_ID = 0x3FF
+	};
 
-	//Search for the location where the string is located.
-	while (se->id != END_OF_STRING_DICTIONARY && se->id != stringId) 
-		++se;
-	
-	debug(DBG_VIDEO, "drawString(%d, %d, %d, '%s')", color, x, y, se->str);
+	struct Line {
+		uint16_t start;
+		uint16_t len;
+	};
+
+	struct String {
+		const char *str;
+		uint16_t firstLine;
+		uint16_t numLines;
+	};
+
+	struct GlyphRow {
+		GlyphRowBits on;
+		GlyphRowBits spill;
+	};
+
+	String strings[MAX_STRING_ID + 1];
+	std::vector<Line> lines;
+	GlyphRow glyphRows[256];
+
+	TextTables() {
+		// With duplicated ids, the first entry is kept, as the scan of the table did
+		memset(strings, 0, sizeof(strings));
+		for (const StrEntry *se = Video::_stringsTableEng; se->id != END_OF_STRING_DICTIONARY; ++se) {
+			if (se->id <= MAX_STRING_ID && strings[se->id].str == 0) {
+				String &s = strings[se->id];
+				s.str = se->str;
+				s.firstLine = lines.size();
+				uint16_t start = 0;
+				for (uint16_t i = 0;; ++i) {
+					if (se->str[i] == '\n' || se->str[i] == 0) {
+						lines.push_back({ start, (uint16_t)(i - start) });
+						start = i + 1;
+					}
+					if (se->str[i] == 0)
+						break;
+				}
+				s.numLines = lines.size() - s.firstLine;
+			}
+		}
+
+		for (int v = 0; v < 256; ++v) {
+			uint8_t on[sizeof(GlyphRowBits)] = { 0 };
+			uint8_t spill[sizeof(GlyphRowBits)] = { 0 };
+			for (int i = 0; i < 4; ++i) {
+				const bool left = (v & (0x80 >> (i * 2))) != 0;
+				const bool right = (v & (0x40 >> (i * 2))) != 0;
+#ifdef VIDEO_8BPP
+				on[i * 2 + 0] = left ? 0xFF : 0;
+				on[i * 2 + 1] = right ? 0xFF : 0;
+				spill[i * 2] = right ? 0xFF : 0;
+#else
+				on[i] = (left ? 0xF0 : 0) | (right ? 0x0F : 0);
+				spill[i] = right ? 0xF0 : 0;
+#endif
+			}
+			memcpy(&glyphRows[v].on, on, sizeof(on));
+			memcpy(&glyphRows[v].spill, spill, sizeof(spill));
+		}
+	}
+};
+
+static const TextTables &getTextTables() {
+	static const TextTables tables;
+	return tables;
+}
+
+void Video::drawString(uint8_t color, uint16_t x, uint16_t y, uint16_t stringId) {
+	if (_doRendering == false) {
+		if (_deferRendering) {
+			DisplayCommand *dc = recordCommand(DisplayCommand::DC_STRING, getPageIndex(_curPagePtr1));
+			dc->offset = stringId;
+			dc->color = color;
+			dc->x = x;
+			dc->y = y;
+		}
+		return;
+	}
 
 	//Not found
-	if (se->id == END_OF_STRING_DICTIONARY)
+	const TextTables &tables = getTextTables();
+	if (stringId > TextTables::MAX_STRING_ID || tables.strings[stringId].str == 0)
 		return;
-	
+	const TextTables::String &se = tables.strings[stringId];
 
-    //Used if the string contains a return carriage.
-	uint16_t xOrigin = x;
-	int len = strlen(se->str);
-	for (int i = 0; i < len; ++i) {
+	debug(DBG_VIDEO, "drawString(%d, %d, %d, '%s')", color, x, y, se.str);
 
-		if (se->str[i] == '\n') {
-			y += 8;
-			x = xOrigin;
-			continue;
-		} 
-		
-		drawChar(se->str[i], x, y, color, _curPagePtr1);
-		x++;
-		
+	// Every line starts at x, 8 pixels below the previous one
+	for (int l = 0; l < se.numLines; ++l) {
+		const TextTables::Line &line = tables.lines[se.firstLine + l];
+		const char *str = se.str + line.start;
+		for (int i = 0; i < line.len; ++i)
+			drawChar(str[i], x + i, y, color, _curPagePtr1);
+		y += 8;
 	}
 }
 
@@ -284,28 +591,26 @@ void Video::drawChar(uint8_t character, uint16_t x, uint16_t y, uint8_t color, u
 	if (x <= 39 && y <= 192) {
 		
 		const uint8_t *ft = _font + (character - ' ') * 8;
+		const TextTables::GlyphRow *glyphRows = getTextTables().glyphRows;
 
-		uint8_t *p = buf + x * 4 + y * 160;
+		uint8_t *p = buf + (x * 4 + y * 160) * PAIR_SIZE;
+
+		const GlyphRowBits bytes = (GlyphRowBits)0x0101010101010101ULL;
+#ifdef VIDEO_8BPP
+		const GlyphRowBits colorBits = bytes * (color & 0xF);
+		const GlyphRowBits spillBits = bytes * (color >> 4);
+#else
+		const GlyphRowBits colorBits = bytes * ((color & 0xF) * 0x11);
+		const GlyphRowBits spillBits = bytes * (color & 0xF0);
+#endif
 
 		for (int j = 0; j < 8; ++j) {
-			uint8_t ch = *(ft + j);
-			for (int i = 0; i < 4; ++i) {
-				uint8_t b = *(p + i);
-				uint8_t cmask = 0xFF;
-				uint8_t colb = 0;
-				if (ch & 0x80) {
-					colb |= color << 4;
-					cmask &= 0x0F;
-				}
-				ch <<= 1;
-				if (ch & 0x80) {
-					colb |= color;
-					cmask &= 0xF0;
-				}
-				ch <<= 1;
-				*(p + i) = (b & cmask) | colb;
-			}
-			p += 160;
+			const TextTables::GlyphRow &row = glyphRows[ft[j]];
+			GlyphRowBits pixels;
+			memcpy(&pixels, p, sizeof(pixels));
+			pixels = (pixels & ~row.on) | (row.on & colorBits) | (row.spill & spillBits);
+			memcpy(p, &pixels, sizeof(pixels));
+			p += VID_PITCH;
 		}
 	}
 }
@@ -314,7 +619,7 @@ void Video::drawPoint(uint8_t color, int16_t x, int16_t y) {
 	if (_doRendering == false) return;
 	debug(DBG_VIDEO, "drawPoint(%d, %d, %d)", color, x, y);
 	if (x >= 0 && x <= 319 && y >= 0 && y <= 199) {
-		uint16_t off = y * 160 + x / 2;
+		uint32_t off = (y * 160 + x / 2) * PAIR_SIZE;
 	
 		uint8_t cmasko, cmaskn;
 		if (x & 1) {
@@ -331,20 +636,24 @@ void Video::drawPoint(uint8_t color, int16_t x, int16_t y) {
 			cmasko = ~cmaskn;
 			colb = 0x88;		
 		} else if (color == 0x11) {
-			colb = *(_pages[0] + off);
+			colb = loadPair(_pages[0] + off);
 		}
-		uint8_t b = *(_curPagePtr1 + off);
-		*(_curPagePtr1 + off) = (b & cmasko) | (colb & cmaskn);
+		uint8_t b = loadPair(_curPagePtr1 + off);
+		storePair(_curPagePtr1 + off, (b & cmasko) | (colb & cmaskn));
 	}
 }
 
 /* Blend a line in the current framebuffer (_curPagePtr1)
+   The drawLine* functions are only called by fillPolygon, which already
+   checked _doRendering.
 */
 void Video::drawLineBlend(int16_t x1, int16_t x2, uint8_t color) {
-	if (_doRendering == false) return;
 	debug(DBG_VIDEO, "drawLineBlend(%d, %d, %d)", x1, x2, color);
 	int16_t xmax = MAX(x1, x2);
 	int16_t xmin = MIN(x1, x2);
+#ifdef VIDEO_8BPP
+	blendSpan(_curPagePtr1 + _hliney * VID_PITCH + xmin, xmax - xmin + 1, 0x07, 0x08);
+#else
 	uint8_t *p = _curPagePtr1 + _hliney * 160 + xmin / 2;
 
 	uint16_t w = xmax / 2 - xmin / 2 + 1;
@@ -363,23 +672,24 @@ void Video::drawLineBlend(int16_t x1, int16_t x2, uint8_t color) {
 		*p = (*p & cmasks) | 0x08;
 		++p;
 	}
-	while (w--) {
-		*p = (*p & 0x77) | 0x88;
-		++p;
-	}
+	blendSpan(p, w, 0x77, 0x88);
+	p += w;
 	if (cmaske != 0) {
 		*p = (*p & cmaske) | 0x80;
 		++p;
 	}
+#endif
 
 
 }
 
 void Video::drawLineN(int16_t x1, int16_t x2, uint8_t color) {
-	if (_doRendering == false) return;
 	debug(DBG_VIDEO, "drawLineN(%d, %d, %d)", x1, x2, color);
 	int16_t xmax = MAX(x1, x2);
 	int16_t xmin = MIN(x1, x2);
+#ifdef VIDEO_8BPP
+	fillSpan(_curPagePtr1 + _hliney * VID_PITCH + xmin, color & 0xF, xmax - xmin + 1);
+#else
 	uint8_t *p = _curPagePtr1 + _hliney * 160 + xmin / 2;
 
 	uint16_t w = xmax / 2 - xmin / 2 + 1;
@@ -399,22 +709,25 @@ void Video::drawLineN(int16_t x1, int16_t x2, uint8_t color) {
 		*p = (*p & cmasks) | (colb & 0x0F);
 		++p;
 	}
-	while (w--) {
-		*p++ = colb;
-	}
+	fillSpan(p, colb, w);
+	p += w;
 	if (cmaske != 0) {
 		*p = (*p & cmaske) | (colb & 0xF0);
 		++p;		
 	}
+#endif
 
 	
 }
 
 void Video::drawLineP(int16_t x1, int16_t x2, uint8_t color) {
-	if (_doRendering == false) return;
 	debug(DBG_VIDEO, "drawLineP(%d, %d, %d)", x1, x2, color);
 	int16_t xmax = MAX(x1, x2);
 	int16_t xmin = MIN(x1, x2);
+#ifdef VIDEO_8BPP
+	uint32_t off = _hliney * VID_PITCH + xmin;
+	copySpan(_curPagePtr1 + off, _pages[0] + off, xmax - xmin + 1);
+#else
 	uint16_t off = _hliney * 160 + xmin / 2;
 	uint8_t *p = _curPagePtr1 + off;
 	uint8_t *q = _pages[0] + off;
@@ -436,14 +749,15 @@ void Video::drawLineP(int16_t x1, int16_t x2, uint8_t color) {
 		++p;
 		++q;
 	}
-	while (w--) {
-		*p++ = *q++;			
-	}
+	copySpan(p, q, w);
+	p += w;
+	q += w;
 	if (cmaske != 0) {
 		*p = (*p & cmaske) | (*q & 0xF0);
 		++p;
 		++q;
 	}
+#endif
 
 }
 
@@ -471,7 +785,7 @@ uint8_t *Video::getPage(uint8_t page) {
 
 
 void Video::changePagePtr1(uint8_t pageID) {
-	if (_doRendering == false) return;
+	if (_doRendering == false && _deferRendering == false) return;
 	debug(DBG_VIDEO, "Video::changePagePtr1(%d)", pageID);
 	_curPagePtr1 = getPage(pageID);
 }
@@ -479,21 +793,35 @@ void Video::changePagePtr1(uint8_t pageID) {
 
 
 void Video::fillPage(uint8_t pageId, uint8_t color) {
-	if (_doRendering == false) return;
+	if (_doRendering == false && _deferRendering == false) return;
 	debug(DBG_VIDEO, "Video::fillPage(%d, %d)", pageId, color);
 	uint8_t *p = getPage(pageId);
+	if (_doRendering == false) {
+		recordCommand(DisplayCommand::DC_FILL_PAGE, getPageIndex(p))->color = color;
+		return;
+	}
 
 	// Since a palette indice is coded on 4 bits, we need to duplicate the
 	// clearing color to the upper part of the byte.
 	uint8_t c = (color << 4) | color;
 
+#ifdef VIDEO_8BPP
+	// Colors above 15 give two different pixels
+	if ((c >> 4) == (c & 0xF)) {
+		memset(p, c & 0xF, VID_PAGE_SIZE);
+	} else {
+		for (int i = 0; i < VID_PAGE_SIZE; i += 2)
+			storePair(p + i, c);
+	}
+#else
 	memset(p, c, VID_PAGE_SIZE);
+#endif
 }
 
 /*  This opcode is used once the background of a scene has been drawn in one of the framebuffer:
 	   it is copied in the current framebuffer at the start of a new frame in order to improve performances. */
 void Video::copyPage(uint8_t srcPageId, uint8_t dstPageId, int16_t vscroll) {
-if (_doRendering == false) return;
+	if (_doRendering == false && _deferRendering == false) return;
 	debug(DBG_VIDEO, "Video::copyPage(%d, %d)", srcPageId, dstPageId);
 
 	if (srcPageId == dstPageId)
@@ -505,21 +833,31 @@ if (_doRendering == false) return;
 	if (srcPageId >= 0xFE || !((srcPageId &= 0xBF) & 0x80)) {
 		p = getPage(srcPageId);
 		q = getPage(dstPageId);
+		if (_doRendering == false) {
+			recordCommand(DisplayCommand::DC_COPY_PAGE, getPageIndex(q))->srcPage = getPageIndex(p);
+			return;
+		}
 		memcpy(q, p, VID_PAGE_SIZE);
 			
 	} else {
 		p = getPage(srcPageId & 3);
 		q = getPage(dstPageId);
+		if (_doRendering == false) {
+			DisplayCommand *dc = recordCommand(DisplayCommand::DC_SCROLL_PAGE, getPageIndex(q));
+			dc->srcPage = getPageIndex(p);
+			dc->y = vscroll;
+			return;
+		}
 		if (vscroll >= -199 && vscroll <= 199) {
 			uint16_t h = 200;
 			if (vscroll < 0) {
 				h += vscroll;
-				p += -vscroll * 160;
+				p += -vscroll * VID_PITCH;
 			} else {
 				h -= vscroll;
-				q += vscroll * 160;
+				q += vscroll * VID_PITCH;
 			}
-			memcpy(q, p, h * 160);
+			memcpy(q, p, h * VID_PITCH);
 		}
 	}
 }
@@ -527,34 +865,26 @@ if (_doRendering == false) return;
 
 
 
+// Converts a planar bitmap (see planar.h) into page 0
 void Video::copyPage(const uint8_t *src) {
-	if (_doRendering == false) return;
+	if (_doRendering == false) {
+		if (_deferRendering == false) return;
+		// The bitmap is only valid now: draw what is pending, except on page 0 which gets replaced
+		rasterize(0x0E);
+	}
 	debug(DBG_VIDEO, "Video::copyPage()");
 	uint8_t *dst = _pages[0];
-	int h = 200;
-	while (h--) {
-		int w = 40;
-		while (w--) {
-			uint8_t p[] = {
-				*(src + 8000 * 3),
-				*(src + 8000 * 2),
-				*(src + 8000 * 1),
-				*(src + 8000 * 0)
-			};
-			for(int j = 0; j < 4; ++j) {
-				uint8_t acc = 0;
-				for (int i = 0; i < 8; ++i) {
-					acc <<= 1;
-					acc |= (p[i & 3] & 0x80) ? 1 : 0;
-					p[i & 3] <<= 1;
-				}
-				*dst++ = acc;
-			}
-			++src;
-		}
+#if defined(__SSE2__)
+	for (int i = 0; i < PLANAR_PLANE_SIZE; i += 16) {
+		planarToChunky16<PAIR_SIZE == 2>(src + i, dst);
+		dst += 16 * 4 * PAIR_SIZE;
 	}
-
-
+#else
+	for (int i = 0; i < PLANAR_PLANE_SIZE; ++i) {
+		planarToChunky<PAIR_SIZE == 2>(src + i, dst);
+		dst += 4 * PAIR_SIZE;
+	}
+#endif
 }
 
 /*
@@ -563,7 +893,7 @@ Note: The palettes set used to be allocated on the stack but I moved it to
 	  frames are generated.
 */
 void Video::changePal(uint8_t palNum) {
-	if (_doRendering == false) return;
+	if (_doRendering == false && _deferRendering == false) return;
  
 	if (palNum >= 32)
 		return;
@@ -571,11 +901,28 @@ void Video::changePal(uint8_t palNum) {
 	uint8_t *p = res->segPalettes + palNum * 32; //colors are coded on 2bytes (565) for 16 colors = 32
 	sys->setPalette(p);
 	currentPaletteId = palNum;
+
+	// Same conversion as the systems, kept for the headless observations
+	for (int i = 0; i < 16; ++i) {
+		uint8_t c1 = p[i * 2 + 0];
+		uint8_t c2 = p[i * 2 + 1];
+		uint8_t r = (((c1 & 0x0F) << 2) | ((c1 & 0x0F) >> 2)) << 2;
+		uint8_t g = (((c2 & 0xF0) >> 2) | ((c2 & 0xF0) >> 6)) << 2;
+		uint8_t b = (((c2 & 0x0F) >> 2) | ((c2 & 0x0F) << 2)) << 2;
+		uint8_t rgba[4] = { r, g, b, 0xFF };
+		memcpy(&_paletteRGBA[i], rgba, 4);
+		for (int c = 0; c < 4; ++c)
+			_paletteChannels[c][i] = rgba[c];
+	}
+	for (int i = 0; i < 256; ++i) {
+		_paletteRGBAPairs[i][0] = _paletteRGBA[i >> 4];
+		_paletteRGBAPairs[i][1] = _paletteRGBA[i & 0xF];
+	}
 }
 
 void Video::updateDisplay(uint8_t pageId) {
 
-if (_doRendering == false) return;
+	if (_doRendering == false && _deferRendering == false) return;
 
 	debug(DBG_VIDEO, "Video::updateDisplay(%d)", pageId);
 
@@ -593,15 +940,235 @@ if (_doRendering == false) return;
 		paletteIdRequested = NO_PALETTE_CHANGE_REQUESTED;
 	}
 
+	if (_doRendering == false) {
+		recordCommand(DisplayCommand::DC_DISPLAY, getPageIndex(_curPagePtr2));
+		return;
+	}
+
 	//Q: Why 160 ?
 	//A: Because one byte gives two palette indices so
 	//   we only need to move 320/2 per line.
+#ifdef VIDEO_8BPP
+	sys->updateDisplayUnpacked(_curPagePtr2);
+#else
   sys->updateDisplay(_curPagePtr2);
+#endif
+}
+
+/*
+	Deferred rendering. Draw calls are recorded with the physical pages they
+	use, page pointers and palettes are still updated as they happen. Polygon
+	data stays valid until the next part is set up, when the list is drawn.
+*/
+uint8_t Video::getPageIndex(const uint8_t *page) const {
+	for (uint8_t i = 0; i < 4; ++i) {
+		if (_pages[i] == page)
+			return i;
+	}
+	return 0;
+}
+
+DisplayCommand *Video::recordCommand(uint8_t type, uint8_t dstPage) {
+	if (_displayListSize == DISPLAY_LIST_SIZE) {
+		compactDisplayList(0x0F);
+		if (_displayListSize > DISPLAY_LIST_SIZE / 2)
+			rasterize();
+	}
+	DisplayCommand *dc = &_displayList[_displayListSize++];
+	dc->type = type;
+	dc->dstPage = dstPage;
+	return dc;
+}
+
+/*
+	Drops the commands that do not change the final content of the pages in
+	'livePages' nor the last displayed frame: the ones drawing on a page that
+	is later filled or copied over before anything reads it.
+*/
+void Video::compactDisplayList(uint8_t livePages) {
+	bool keep[DISPLAY_LIST_SIZE];
+	bool displayed = false;
+	uint8_t live = livePages;
+
+	for (int i = _displayListSize - 1; i >= 0; --i) {
+		const DisplayCommand *dc = &_displayList[i];
+		const uint8_t dst = 1 << dc->dstPage;
+		switch (dc->type) {
+		case DisplayCommand::DC_DISPLAY:
+			keep[i] = !displayed;
+			displayed = true;
+			if (keep[i])
+				live |= dst;
+			break;
+		case DisplayCommand::DC_FILL_PAGE:
+			keep[i] = (live & dst) != 0;
+			live &= ~dst;
+			break;
+		case DisplayCommand::DC_COPY_PAGE:
+			keep[i] = (live & dst) != 0 && dc->srcPage != dc->dstPage;
+			if (keep[i])
+				live = (live & ~dst) | (1 << dc->srcPage);
+			break;
+		case DisplayCommand::DC_SCROLL_PAGE:
+			keep[i] = (live & dst) != 0;
+			if (keep[i])
+				live |= 1 << dc->srcPage;
+			break;
+		default:
+			// Polygons may copy pixels from page 0
+			keep[i] = (live & dst) != 0;
+			if (keep[i] && dc->type == DisplayCommand::DC_POLYGON)
+				live |= 1;
+			break;
+		}
+	}
+
+	uint16_t n = 0;
+	for (uint16_t i = 0; i < _displayListSize; ++i) {
+		if (keep[i])
+			_displayList[n++] = _displayList[i];
+	}
+	_displayListSize = n;
+}
+
+// Draws the recorded commands, only the pages in 'livePages' need to be up to date afterwards
+void Video::rasterize(uint8_t livePages) {
+	if (_displayListSize == 0)
+		return;
+
+	compactDisplayList(livePages);
+
+	uint8_t *curPagePtr1 = _curPagePtr1;
+	_doRendering = true;
+
+	for (uint16_t i = 0; i < _displayListSize; ++i) {
+		const DisplayCommand *dc = &_displayList[i];
+		switch (dc->type) {
+		case DisplayCommand::DC_POLYGON:
+			_curPagePtr1 = _pages[dc->dstPage];
+			setDataBuffer((uint8_t *)dc->data, dc->offset);
+			readAndDrawPolygon(dc->color, dc->zoom, Point(dc->x, dc->y));
+			break;
+		case DisplayCommand::DC_STRING:
+			_curPagePtr1 = _pages[dc->dstPage];
+			drawString(dc->color, dc->x, dc->y, dc->offset);
+			break;
+		case DisplayCommand::DC_FILL_PAGE:
+			fillPage(dc->dstPage, dc->color);
+			break;
+		case DisplayCommand::DC_COPY_PAGE:
+			copyPage(dc->srcPage, dc->dstPage, 0);
+			break;
+		case DisplayCommand::DC_SCROLL_PAGE:
+			copyPage(dc->srcPage | 0x80, dc->dstPage, dc->y);
+			break;
+		case DisplayCommand::DC_DISPLAY:
+#ifdef VIDEO_8BPP
+			sys->updateDisplayUnpacked(_pages[dc->dstPage]);
+#else
+			sys->updateDisplay(_pages[dc->dstPage]);
+#endif
+			break;
+		}
+	}
+
+	_doRendering = false;
+	_curPagePtr1 = curPagePtr1;
+	_displayListSize = 0;
+}
+
+/*
+	Headless observations of the displayed page (_curPagePtr2), for agents that
+	read frames directly instead of going through System::updateDisplay.
+*/
+
+// Splits 'n' packed bytes (n multiple of 16) into two palette indices each
+static inline void unpackNibbles(const uint8_t *src, uint8_t *dst, uint32_t n) {
+	uint32_t i = 0;
+#if defined(__SSE2__)
+	const __m128i m = _mm_set1_epi8(0x0F);
+	for (; i < n; i += 16) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+		__m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), m);
+		__m128i lo = _mm_and_si128(v, m);
+		_mm_storeu_si128((__m128i *)(dst + i * 2 + 0), _mm_unpacklo_epi8(hi, lo));
+		_mm_storeu_si128((__m128i *)(dst + i * 2 + 16), _mm_unpackhi_epi8(hi, lo));
+	}
+#endif
+	for (; i < n; ++i) {
+		dst[i * 2 + 0] = src[i] >> 4;
+		dst[i * 2 + 1] = src[i] & 0xF;
+	}
+}
+
+void Video::getObservationIndexed(uint8_t *dst) const {
+#ifdef VIDEO_8BPP
+	memcpy(dst, _curPagePtr2, VID_NUM_PIXELS);
+#else
+	unpackNibbles(_curPagePtr2, dst, VID_PAGE_SIZE);
+#endif
+}
+
+#if defined(OBSERVATION_SSSE3_TARGET)
+static inline bool hasSSSE3() {
+#if defined(OBSERVATION_SSSE3_DISPATCH)
+	static const bool supported = __builtin_cpu_supports("ssse3");
+	return supported;
+#else
+	return true;
+#endif
+}
+
+// One 16 byte table per channel, looked up 16 indices at a time
+OBSERVATION_SSSE3_TARGET static void lookupPaletteSSSE3(const uint8_t *page, const uint8_t channels[4][16], uint8_t *out) {
+	const __m128i tr = _mm_loadu_si128((const __m128i *)channels[0]);
+	const __m128i tg = _mm_loadu_si128((const __m128i *)channels[1]);
+	const __m128i tb = _mm_loadu_si128((const __m128i *)channels[2]);
+	const __m128i ta = _mm_loadu_si128((const __m128i *)channels[3]);
+#ifndef VIDEO_8BPP
+	const __m128i m = _mm_set1_epi8(0x0F);
+#endif
+
+	for (uint32_t i = 0; i < Video::VID_NUM_PIXELS; i += 16) {
+#ifdef VIDEO_8BPP
+		__m128i idx = _mm_loadu_si128((const __m128i *)(page + i));
+#else
+		__m128i v = _mm_loadl_epi64((const __m128i *)(page + i / 2));
+		__m128i idx = _mm_unpacklo_epi8(_mm_and_si128(_mm_srli_epi16(v, 4), m), _mm_and_si128(v, m));
+#endif
+		__m128i r = _mm_shuffle_epi8(tr, idx);
+		__m128i g = _mm_shuffle_epi8(tg, idx);
+		__m128i b = _mm_shuffle_epi8(tb, idx);
+		__m128i a = _mm_shuffle_epi8(ta, idx);
+		__m128i rgLo = _mm_unpacklo_epi8(r, g);
+		__m128i rgHi = _mm_unpackhi_epi8(r, g);
+		__m128i baLo = _mm_unpacklo_epi8(b, a);
+		__m128i baHi = _mm_unpackhi_epi8(b, a);
+		_mm_storeu_si128((__m128i *)(out + i * 4 + 0), _mm_unpacklo_epi16(rgLo, baLo));
+		_mm_storeu_si128((__m128i *)(out + i * 4 + 16), _mm_unpackhi_epi16(rgLo, baLo));
+		_mm_storeu_si128((__m128i *)(out + i * 4 + 32), _mm_unpacklo_epi16(rgHi, baHi));
+		_mm_storeu_si128((__m128i *)(out + i * 4 + 48), _mm_unpackhi_epi16(rgHi, baHi));
+	}
+}
+#endif
+
+void Video::getObservation(uint32_t *rgba) const {
+#if defined(OBSERVATION_SSSE3_TARGET)
+	if (hasSSSE3()) {
+		lookupPaletteSSSE3(_curPagePtr2, _paletteChannels, (uint8_t *)rgba);
+		return;
+	}
+#endif
+	// Two pixels at once
+	for (uint32_t i = 0; i < VID_PACKED_PAGE_SIZE; ++i)
+		memcpy(rgba + i * 2, _paletteRGBAPairs[loadPair(_curPagePtr2 + i * PAIR_SIZE)], 8);
 }
 
 void Video::saveOrLoad(Serializer &ser) {
 	uint8_t mask = 0;
 	if (ser._mode == Serializer::SM_SAVE) {
+		if (ser._buffer != nullptr)
+			rasterize();
 		for (int i = 0; i < 4; ++i) {
 			if (_pages[i] == _curPagePtr1)
 				mask |= i << 4;
@@ -611,19 +1178,44 @@ void Video::saveOrLoad(Serializer &ser) {
 				mask |= i << 0;
 		}		
 	}
+
+#ifdef VIDEO_8BPP
+	// Pages are stored packed, two pixels per byte
+	uint8_t **pages = _packedPages;
+	if (ser._mode == Serializer::SM_SAVE && ser._buffer != nullptr) {
+		for (int i = 0; i < 4; ++i) {
+			for (int j = 0; j < VID_PACKED_PAGE_SIZE; ++j)
+				_packedPages[i][j] = loadPair(_pages[i] + j * 2);
+		}
+	}
+#else
+	uint8_t **pages = _pages;
+#endif
+
 	Serializer::Entry entries[] = {
 		SE_INT(&currentPaletteId, Serializer::SES_INT8, VER(1)),
 		SE_INT(&paletteIdRequested, Serializer::SES_INT8, VER(1)),
 		SE_INT(&mask, Serializer::SES_INT8, VER(1)),
-		SE_ARRAY(_pages[0], Video::VID_PAGE_SIZE, Serializer::SES_INT8, VER(1)),
-		SE_ARRAY(_pages[1], Video::VID_PAGE_SIZE, Serializer::SES_INT8, VER(1)),
-		SE_ARRAY(_pages[2], Video::VID_PAGE_SIZE, Serializer::SES_INT8, VER(1)),
-		SE_ARRAY(_pages[3], Video::VID_PAGE_SIZE, Serializer::SES_INT8, VER(1)),
+		SE_ARRAY(pages[0], Video::VID_PACKED_PAGE_SIZE, Serializer::SES_INT8, VER(1)),
+		SE_ARRAY(pages[1], Video::VID_PACKED_PAGE_SIZE, Serializer::SES_INT8, VER(1)),
+		SE_ARRAY(pages[2], Video::VID_PACKED_PAGE_SIZE, Serializer::SES_INT8, VER(1)),
+		SE_ARRAY(pages[3], Video::VID_PACKED_PAGE_SIZE, Serializer::SES_INT8, VER(1)),
 		SE_END()
 	};
 	ser.saveOrLoadEntries(entries);
 
 	if (ser._mode == Serializer::SM_LOAD) {
+		// The pages are replaced, and the recorded polygon data may be too
+		_displayListSize = 0;
+		invalidateVertexCache();
+#ifdef VIDEO_8BPP
+		if (ser._buffer != nullptr) {
+			for (int i = 0; i < 4; ++i) {
+				for (int j = 0; j < VID_PACKED_PAGE_SIZE; ++j)
+					storePair(_pages[i] + j * 2, _packedPages[i][j]);
+			}
+		}
+#endif
 		_curPagePtr1 = _pages[(mask >> 4) & 0x3];
 		_curPagePtr2 = _pages[(mask >> 2) & 0x3];
 		_curPagePtr3 = _pages[(mask >> 0) & 0x3];
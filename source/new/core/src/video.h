@@ -38,10 +38,41 @@ struct Polygon {
 	void readVertices(const uint8_t *p, uint16_t zoom);
 };
 
+// A polygon scaled from its vertex data, see Video::getPolygon
+struct VertexCacheEntry {
+	const uint8_t *src;
+	uint16_t zoom;
+	Polygon polygon;
+};
+
 struct Resource;
 struct Serializer;
 struct System;
 
+/*
+	A draw call recorded while rendering is deferred. Pages are the physical
+	pages (0-3) the call used when it was recorded.
+*/
+struct DisplayCommand {
+	enum {
+		DC_POLYGON,
+		DC_STRING,
+		DC_FILL_PAGE,
+		DC_COPY_PAGE,
+		DC_SCROLL_PAGE,
+		DC_DISPLAY
+	};
+
+	uint8_t type;
+	uint8_t dstPage;
+	uint8_t srcPage;
+	uint8_t color;
+	uint16_t zoom;
+	uint16_t offset;     // polygon data offset or string id
+	int16_t x, y;        // y is the vertical scroll of DC_SCROLL_PAGE
+	const uint8_t *data; // polygon data buffer
+};
+
 // This is used to detect the end of  _stringsTableEng and _stringsTableDemo
 #define END_OF_STRING_DICTIONARY 0xFFFF 
 
@@ -53,8 +84,20 @@ struct System;
 struct Video {
 	typedef void (Video::*drawLine)(int16_t x1, int16_t x2, uint8_t col);
 
+	// With VIDEO_8BPP the pages hold one pixel (palette index) per byte instead
+	// of two. Savestates always use the packed format (VID_PACKED_PAGE_SIZE).
 	enum {
-		VID_PAGE_SIZE  = 320 * 200 / 2
+#ifdef VIDEO_8BPP
+		VID_PAGE_SIZE  = 320 * 200,
+		VID_PITCH      = 320,
+#else
+		VID_PAGE_SIZE  = 320 * 200 / 2,
+		VID_PITCH      = 160,
+#endif
+		VID_PACKED_PAGE_SIZE = 320 * 200 / 2,
+		VID_NUM_PIXELS = 320 * 200,
+		DISPLAY_LIST_SIZE = 1024,
+		VERTEX_CACHE_SIZE = 256
 	};
 
 	static const uint8_t _font[];
@@ -67,6 +110,12 @@ struct Video {
 
 
 	uint8_t paletteIdRequested, currentPaletteId;
+
+	// Current palette as 32-bit pixels (bytes R, G, B, A in memory), set by changePal
+	uint32_t _paletteRGBA[16];
+	// The same colors for the observation lookups: by packed byte (two pixels), and by channel
+	uint32_t _paletteRGBAPairs[256][2];
+	uint8_t _paletteChannels[4][16];
 	uint8_t *_pages[4];
 
 	// I am almost sure that:
@@ -75,7 +124,14 @@ struct Video {
 	// _curPagePtr3 is the background buffer2
 	uint8_t *_curPagePtr1, *_curPagePtr2, *_curPagePtr3;
 
-	Polygon polygon;
+#ifdef VIDEO_8BPP
+	// Packed copies of the pages, used to save and load states
+	uint8_t *_packedPages[4];
+#endif
+
+	// Scaled polygons by vertex data and zoom (direct mapped), valid until the
+	// polygon data changes: part setup and state loads
+	VertexCacheEntry _vertexCache[VERTEX_CACHE_SIZE];
 	int16_t _hliney;
 
 	//Precomputer division lookup table
@@ -85,21 +141,30 @@ struct Video {
 	uint8_t *_dataBuf;
 	bool _doRendering = false;
 
+	// With _doRendering off and _deferRendering on, draw calls are only recorded.
+	// rasterize() draws them when the pages or the frame are actually needed.
+	bool _deferRendering = false;
+	DisplayCommand _displayList[DISPLAY_LIST_SIZE];
+	uint16_t _displayListSize = 0;
+
 	Video(Resource *res, System *stub);
 	void init();
 
 	void setDataBuffer(uint8_t *dataBuf, uint16_t offset);
 	void readAndDrawPolygon(uint8_t color, uint16_t zoom, const Point &pt);
-	void fillPolygon(uint16_t color, uint16_t zoom, const Point &pt);
+	const Polygon &getPolygon(const uint8_t *p, uint16_t zoom);
+	void invalidateVertexCache();
+	void fillPolygon(const Polygon &polygon, uint16_t color, const Point &pt);
+	template <drawLine DRAW_LINE> void fillPolygonLines(const Polygon &polygon, uint16_t color, int16_t x1);
 	void readAndDrawPolygonHierarchy(uint16_t zoom, const Point &pt);
-	int32_t calcStep(const Point &p1, const Point &p2, uint16_t &dy);
+	inline int32_t calcStep(const Point &p1, const Point &p2, uint16_t &dy);
 
 	void drawString(uint8_t color, uint16_t x, uint16_t y, uint16_t strId);
 	void drawChar(uint8_t c, uint16_t x, uint16_t y, uint8_t color, uint8_t *buf);
 	void drawPoint(uint8_t color, int16_t x, int16_t y);
-	void drawLineBlend(int16_t x1, int16_t x2, uint8_t color);
-	void drawLineN(int16_t x1, int16_t x2, uint8_t color);
-	void drawLineP(int16_t x1, int16_t x2, uint8_t color);
+	inline void drawLineBlend(int16_t x1, int16_t x2, uint8_t color);
+	inline void drawLineN(int16_t x1, int16_t x2, uint8_t color);
+	inline void drawLineP(int16_t x1, int16_t x2, uint8_t color);
 	uint8_t *getPage(uint8_t page);
 	void changePagePtr1(uint8_t page);
 	void fillPage(uint8_t page, uint8_t color);
@@ -107,6 +172,13 @@ struct Video {
 	void copyPage(const uint8_t *src);
 	void changePal(uint8_t pal);
 	void updateDisplay(uint8_t page);
+
+	uint8_t getPageIndex(const uint8_t *page) const;
+	DisplayCommand *recordCommand(uint8_t type, uint8_t dstPage);
+	void compactDisplayList(uint8_t livePages);
+	void rasterize(uint8_t livePages = 0x0F);
+	void getObservationIndexed(uint8_t *dst) const;
+	void getObservation(uint32_t *rgba) const;
 	
 	void saveOrLoad(Serializer &ser);
 };
@@ -140,6 +140,18 @@ void VirtualMachine::hostFrame() {
 		}
 		
 	}
+
+	// Music rows due during the frame are played once its threads have run, so scripts see their marks from
+	// the next frame on. When audio is mixed offline, Engine::mixFrameAudio plays them between runs of samples
+	if (_musicClock && !mixer->_offline) {
+		player->advanceClock(getFrameDuration());
+	}
+}
+
+// The game shows each frame for VM_VARIABLE_PAUSE_SLICES * 20 ms, which is the time it takes
+uint32_t VirtualMachine::getFrameDuration() const {
+	int16_t slices = vmVariables[VM_VARIABLE_PAUSE_SLICES];
+	return (slices > 0) ? slices * 20 : 0;
 }
 
 #define COLOR_BLACK 0xFF
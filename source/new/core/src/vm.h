@@ -99,6 +99,7 @@ struct VirtualMachine {
 	uint8_t _stackPtr;
 	bool gotoNextThread;
 	bool _doRendering = false;
+	bool _musicClock = false; // See SfxPlayer::_musicClock
 
 	VirtualMachine(Mixer *mix, Resource *res, SfxPlayer *ply, Video *vid, System *stub);
 	void init();
@@ -330,7 +331,7 @@ inline void op_blitFramebuffer() {
 	//WTF ?
 	vmVariables[0xF7] = 0;
 
-	if (_doRendering == true) video->updateDisplay(pageId);
+	if (_doRendering == true || video->_deferRendering == true) video->updateDisplay(pageId);
 }
 
 inline void op_killThread() {
@@ -400,16 +401,17 @@ inline void op_updateMemList() {
 }
 
 inline void op_playMusic() {
-	// uint16_t resNum = _scriptPtr.fetchWord();
-	// uint16_t delay = _scriptPtr.fetchWord();
-	// uint8_t pos = _scriptPtr.fetchByte();
-	// snd_playMusic(resNum, delay, pos);
+	uint16_t resNum = _scriptPtr.fetchWord();
+	uint16_t delay = _scriptPtr.fetchWord();
+	uint8_t pos = _scriptPtr.fetchByte();
+	snd_playMusic(resNum, delay, pos);
 }
 
 	void initForPart(uint16_t partId);
 	void checkThreadRequests();
 	void hostFrame();
 	void executeThread();
+	uint32_t getFrameDuration() const;
 
 	void inp_updatePlayer(bool up, bool down, bool left, bool right, bool fire);
 	void inp_handleSpecialKeys();
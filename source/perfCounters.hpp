@@ -0,0 +1,132 @@
+#pragma once
+
+// Hardware performance counters of the calling thread (perf_event_open)
+// Linux only: on other platforms no counter is available
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+  #include <unistd.h>
+  #include <sys/ioctl.h>
+  #include <sys/syscall.h>
+  #include <linux/perf_event.h>
+#endif
+
+namespace rawspace
+{
+
+namespace perf
+{
+
+// Counts a fixed set of events (cycles, instructions, branch and cache misses) in user space, for the
+// calling thread only. Each counter is opened on its own, so the ones the cpu (or virtual machine)
+// does not provide are reported as unavailable without affecting the rest. If the kernel multiplexes
+// the counters, their values are scaled to the whole measured time.
+class Counters
+{
+  public:
+
+  struct counter_t
+  {
+    std::string name;
+    int fd = -1;
+    double value = 0.0;
+  };
+
+  Counters()
+  {
+#ifdef __linux__
+    const uint64_t cacheReadMiss = (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    addCounter("Cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    addCounter("Instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    addCounter("Branch Misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    addCounter("L1D Read Misses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | cacheReadMiss);
+    addCounter("LLC Read Misses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | cacheReadMiss);
+    addCounter("dTLB Read Misses", PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | cacheReadMiss);
+#endif
+  }
+
+  ~Counters()
+  {
+#ifdef __linux__
+    for (const auto &c : _counters) if (c.fd >= 0) close(c.fd);
+#endif
+  }
+
+  Counters(const Counters &) = delete;
+  Counters &operator=(const Counters &) = delete;
+
+  // Whether any counter could be opened
+  bool isAvailable() const
+  {
+    for (const auto &c : _counters) if (c.fd >= 0) return true;
+    return false;
+  }
+
+  // Resets and starts counting
+  void start()
+  {
+#ifdef __linux__
+    for (const auto &c : _counters) if (c.fd >= 0) ioctl(c.fd, PERF_EVENT_IOC_RESET, 0);
+    for (const auto &c : _counters) if (c.fd >= 0) ioctl(c.fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+  }
+
+  // Stops counting and reads the counter values
+  void stop()
+  {
+#ifdef __linux__
+    for (const auto &c : _counters) if (c.fd >= 0) ioctl(c.fd, PERF_EVENT_IOC_DISABLE, 0);
+
+    for (auto &c : _counters)
+    {
+      if (c.fd < 0) continue;
+
+      // Value, time enabled, time running
+      uint64_t data[3] = {0};
+      if (read(c.fd, data, sizeof(data)) != sizeof(data)) { c.value = 0.0; continue; }
+      c.value = data[2] > 0 ? (double)data[0] * ((double)data[1] / (double)data[2]) : 0.0;
+    }
+#endif
+  }
+
+  // Gets a counter value by name. Returns false if it is unavailable
+  bool getValue(const std::string &name, double &value) const
+  {
+    for (const auto &c : _counters) if (c.name == name && c.fd >= 0) { value = c.value; return true; }
+    return false;
+  }
+
+  const std::vector<counter_t> &getCounters() const { return _counters; }
+
+  private:
+
+#ifdef __linux__
+  void addCounter(const std::string &name, const uint32_t type, const uint64_t config)
+  {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    counter_t c;
+    c.name = name;
+    c.fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    _counters.push_back(c);
+  }
+#endif
+
+  std::vector<counter_t> _counters;
+};
+
+} // namespace perf
+
+} // namespace rawspace
@@ -0,0 +1,136 @@
+#include "argparse/argparse.hpp"
+#include <jaffarCommon/json.hpp>
+#include <jaffarCommon/serializers/contiguous.hpp>
+#include <jaffarCommon/deserializers/contiguous.hpp>
+#include <jaffarCommon/string.hpp>
+#include <jaffarCommon/file.hpp>
+#include "NEORAWInstance.hpp"
+#include <chrono>
+#include <vector>
+#include <string>
+
+// Rasterizer microbenchmark: replays an input sequence from its initial state, first
+// with rendering disabled and then enabled. The difference is the cost of drawing
+// the frames (polygons, spans, page copies and display updates).
+
+// Replays the sequence 'replays' times and returns the elapsed time in seconds
+static double replaySequence(rawspace::EmuInstance &e, const std::vector<jaffar::input_t> &sequence, uint8_t *initialState, const size_t stateSize, const int replays)
+{
+  auto t0 = std::chrono::high_resolution_clock::now();
+  for (int r = 0; r < replays; r++)
+  {
+    jaffarCommon::deserializer::Contiguous d(initialState, stateSize);
+    e.deserializeState(d);
+    for (const auto &input : sequence) e.advanceState(input);
+  }
+  auto tf = std::chrono::high_resolution_clock::now();
+  return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(tf - t0).count() * 1.0e-9;
+}
+
+int main(int argc, char *argv[])
+{
+  // Parsing command line arguments
+  argparse::ArgumentParser program("rasterBench", "1.0");
+
+  program.add_argument("scriptFile")
+    .help("Path to the test script file to run.")
+    .required();
+
+  program.add_argument("sequenceFile")
+    .help("Path to the input sequence file (.sol) to replay.")
+    .required();
+
+  program.add_argument("--replays")
+    .help("Number of times the sequence is replayed in each pass.")
+    .default_value(10)
+    .scan<'i', int>();
+
+  // Try to parse arguments
+  try { program.parse_args(argc, argv); } catch (const std::runtime_error &err) { JAFFAR_THROW_LOGIC("%s\n%s", err.what(), program.help().str().c_str()); }
+
+  const auto scriptFilePath = program.get<std::string>("scriptFile");
+  const auto sequenceFilePath = program.get<std::string>("sequenceFile");
+  const auto replays = program.get<int>("--replays");
+
+  // Loading script file
+  std::string configJsRaw;
+  if (jaffarCommon::file::loadStringFromFile(configJsRaw, scriptFilePath) == false) JAFFAR_THROW_LOGIC("Could not find/read script file: %s\n", scriptFilePath.c_str());
+  const auto configJs = nlohmann::json::parse(configJsRaw);
+  const auto initialStateFilePath = jaffarCommon::json::getString(configJs, "Initial State File");
+  const auto gameDataPath = jaffarCommon::json::getString(configJs, "Game Data Path");
+
+  // Creating and initializing emulator instance
+  auto e = rawspace::EmuInstance(configJs);
+  e.initialize(gameDataPath);
+  e.initializeVideoOutput();
+  e.disableRendering();
+
+  // If an initial state is provided, load it now
+  if (initialStateFilePath != "")
+  {
+    std::string stateFileData;
+    if (jaffarCommon::file::loadStringFromFile(stateFileData, initialStateFilePath) == false) JAFFAR_THROW_LOGIC("Could not initial state file: %s\n", initialStateFilePath.c_str());
+    jaffarCommon::deserializer::Contiguous d(stateFileData.data());
+    e.deserializeState(d);
+  }
+
+  // Keeping the full initial state (including video pages) to restart every replay from it
+  const auto stateSize = e.getStateSize();
+  std::vector<uint8_t> initialState(stateSize);
+  {
+    jaffarCommon::serializer::Contiguous s(initialState.data(), stateSize);
+    e.serializeState(s);
+  }
+
+  // Loading sequence file
+  std::string sequenceRaw;
+  if (jaffarCommon::file::loadStringFromFile(sequenceRaw, sequenceFilePath) == false) JAFFAR_THROW_LOGIC("[ERROR] Could not find or read from input sequence file: %s\n", sequenceFilePath.c_str());
+  const auto sequence = jaffarCommon::string::split(sequenceRaw, ' ');
+  std::vector<jaffar::input_t> decodedSequence;
+  for (const auto &inputString : sequence) decodedSequence.push_back(e.getInputParser()->parseInputString(inputString));
+
+  printf("[] -----------------------------------------\n");
+  printf("[] Running Script:                         '%s'\n", scriptFilePath.c_str());
+  printf("[] Emulation Core:                         '%s'\n", e.getCoreName().c_str());
+  printf("[] Sequence File:                          '%s'\n", sequenceFilePath.c_str());
+  printf("[] Sequence Length:                        %lu\n", decodedSequence.size());
+  printf("[] Replays:                                %d\n", replays);
+  printf("[] ********** Running Benchmark **********\n");
+
+  // Pass without rendering
+  e.disableRendering();
+  const auto timeWithoutRendering = replaySequence(e, decodedSequence, initialState.data(), stateSize, replays);
+
+  // Pass with rendering
+  e.enableRendering();
+  const auto timeWithRendering = replaySequence(e, decodedSequence, initialState.data(), stateSize, replays);
+
+  // Headless observations of the last frame
+  const int observations = replays * 1000;
+  std::vector<uint32_t> observation(rawspace::EmuInstanceBase::OBSERVATION_WIDTH * rawspace::EmuInstanceBase::OBSERVATION_HEIGHT);
+  auto t0 = std::chrono::high_resolution_clock::now();
+  for (int i = 0; i < observations; i++) e.getObservation(observation.data());
+  auto tf = std::chrono::high_resolution_clock::now();
+  const double timeObservations = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(tf - t0).count() * 1.0e-9;
+
+  MetroHash128 observationHash;
+  observationHash.Update(observation.data(), observation.size() * sizeof(uint32_t));
+  jaffarCommon::hash::hash_t observationResult;
+  observationHash.Finalize(reinterpret_cast<uint8_t *>(&observationResult));
+
+  // Hashing the last displayed frame
+  MetroHash128 hash;
+  hash.Update(e.getPixelsPtr(), e.getPixelsSize());
+  jaffarCommon::hash::hash_t result;
+  hash.Finalize(reinterpret_cast<uint8_t *>(&result));
+
+  const double frames = (double)decodedSequence.size() * replays;
+  printf("[] Time Without Rendering:                 %3.3fs (%.3f inputs / s)\n", timeWithoutRendering, frames / timeWithoutRendering);
+  printf("[] Time With Rendering:                    %3.3fs (%.3f inputs / s)\n", timeWithRendering, frames / timeWithRendering);
+  printf("[] Rendering Cost:                         %.3f us / input\n", (timeWithRendering - timeWithoutRendering) * 1.0e6 / frames);
+  printf("[] Final Frame Hash:                       0x%lX%lX\n", result.first, result.second);
+  printf("[] RGBA Observations:                      %.3f / s\n", observations / timeObservations);
+  printf("[] RGBA Observation Hash:                  0x%lX%lX\n", observationResult.first, observationResult.second);
+
+  e.finalizeVideoOutput();
+}
@@ -10,8 +10,15 @@
 #include <jaffarCommon/logger.hpp>
 #include <jaffarCommon/file.hpp>
 #include "NEORAWInstance.hpp"
+#include "perfCounters.hpp"
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <exception>
+#include <memory>
+#include <random>
 #include <sstream>
+#include <thread>
 #include <vector>
 #include <string>
 
@@ -37,11 +44,49 @@ int main(int argc, char *argv[])
     .help("Path to write the hash output to.")
     .default_value(std::string(""));
 
+  program.add_argument("--observationHashOutputFile")
+    .help("Renders every input and writes a hash of the indexed and RGBA observations of all frames to this path, to compare the frames of both cores.")
+    .default_value(std::string(""));
+
   program.add_argument("--warmup")
   .help("Warms up the CPU before running for reduced variation in performance results")
   .default_value(false)
   .implicit_value(true);
 
+  program.add_argument("--cpu")
+    .help("Pins the emulator thread to this cpu before initializing the instance.")
+    .default_value(-1)
+    .scan<'i', int>();
+
+  program.add_argument("--numaNode")
+    .help("Pins the emulator thread to this NUMA node before initializing the instance, so its memory is allocated there.")
+    .default_value(-1)
+    .scan<'i', int>();
+
+  program.add_argument("--runNumaNode")
+    .help("Migrates the emulator thread to this NUMA node before running the test. Use a node other than --numaNode to measure cross-node throughput.")
+    .default_value(-1)
+    .scan<'i', int>();
+
+  program.add_argument("--resourceCounters")
+    .help("Prints the resource I/O counters (bank reads, unpacking, part switches) of the test run.")
+    .default_value(false)
+    .implicit_value(true);
+
+  program.add_argument("--perfCounters")
+    .help("Counts hardware events (cycles, instructions, branch, cache and TLB misses) during the test run and prints them per input.")
+    .default_value(false)
+    .implicit_value(true);
+
+  program.add_argument("--threads")
+    .help("After the test, runs this many independent instances at once (one per thread) and reports how throughput scales.")
+    .default_value(1)
+    .scan<'i', int>();
+
+  program.add_argument("--threadSequence")
+    .help("Sequence replayed by each thread in the scaling run. Possible values: 'Same': the test sequence, 'Offset': the test sequence starting at a different input per thread, and 'Shuffle': the test inputs in a different random order per thread.")
+    .default_value(std::string("Same"));
+
   // Try to parse arguments
   try { program.parse_args(argc, argv); } catch (const std::runtime_error &err) { JAFFAR_THROW_LOGIC("%s\n%s", err.what(), program.help().str().c_str()); }
 
@@ -51,6 +96,10 @@ int main(int argc, char *argv[])
   // Getting path where to save the hash output (if any)
   const auto hashOutputFile = program.get<std::string>("--hashOutputFile");
 
+  // Getting path where to save the observations hash (if any)
+  const auto observationHashOutputFile = program.get<std::string>("--observationHashOutputFile");
+  const bool hashObservations = observationHashOutputFile != "";
+
   // Getting cycle type
   const auto cycleType = program.get<std::string>("--cycleType");
 
@@ -62,6 +111,24 @@ int main(int argc, char *argv[])
   // Getting warmup setting
   const auto useWarmUp = program.get<bool>("--warmup");
 
+  // Getting thread placement settings
+  const auto cpuHint = program.get<int>("--cpu");
+  const auto numaNodeHint = program.get<int>("--numaNode");
+  const auto runNumaNode = program.get<int>("--runNumaNode");
+
+  // Getting resource counters setting
+  const auto printResourceCounters = program.get<bool>("--resourceCounters");
+
+  // Getting hardware performance counters setting
+  const auto usePerfCounters = program.get<bool>("--perfCounters");
+
+  // Getting scaling run settings
+  const auto threadCount = program.get<int>("--threads");
+  if (threadCount < 1) JAFFAR_THROW_LOGIC("Invalid thread count: %d\n", threadCount);
+
+  const auto threadSequence = program.get<std::string>("--threadSequence");
+  if (threadSequence != "Same" && threadSequence != "Offset" && threadSequence != "Shuffle") JAFFAR_THROW_LOGIC("Unrecognized thread sequence: %s\n", threadSequence.c_str());
+
   // Loading script file
   std::string configJsRaw;
   if (jaffarCommon::file::loadStringFromFile(configJsRaw, scriptFilePath) == false) JAFFAR_THROW_LOGIC("Could not find/read script file: %s\n", scriptFilePath.c_str());
@@ -100,26 +167,41 @@ int main(int argc, char *argv[])
   if (differentialCompressionJs["Use Zlib"].is_boolean() == false) JAFFAR_THROW_LOGIC("Script file 'Differential Compression / Use Zlib' entry is not a boolean\n");
   const auto differentialCompressionUseZlib = differentialCompressionJs["Use Zlib"].get<bool>();
 
+  // Loading initial state file, if provided
+  std::string initialStateData;
+  if (initialStateFilePath != "")
+    if (jaffarCommon::file::loadStringFromFile(initialStateData, initialStateFilePath) == false) JAFFAR_THROW_LOGIC("Could not initial state file: %s\n", initialStateFilePath.c_str());
+
+  // Brings an emulator instance to the start of the test. Must run on the thread that will use it
+  auto prepareInstance = [&](rawspace::EmuInstance &e, const int cpu)
+  {
+    // Initializing emulator instance
+    e.initialize(gameDataPath, cpu, numaNodeHint);
+
+    // Disable rendering
+    e.disableRendering();
+
+    // If an initial state is provided, load it now
+    if (initialStateFilePath != "")
+    {
+      jaffarCommon::deserializer::Contiguous d(initialStateData.data());
+      e.deserializeState(d);
+    }
+
+    // Disabling requested blocks from state serialization
+    for (const auto& block : stateDisabledBlocks) e.disableStateBlock(block);
+  };
+
   // Creating emulator instance
   auto e = rawspace::EmuInstance(configJs);
+  prepareInstance(e, cpuHint);
 
-  // Initializing emulator instance
-  e.initialize(gameDataPath);
-
-  // Disable rendering
-  e.disableRendering();
-  
-  // If an initial state is provided, load it now
-  if (initialStateFilePath != "")
+  // Observations need the frames to be rendered
+  if (hashObservations == true)
   {
-    std::string stateFileData;
-    if (jaffarCommon::file::loadStringFromFile(stateFileData, initialStateFilePath) == false) JAFFAR_THROW_LOGIC("Could not initial state file: %s\n", initialStateFilePath.c_str());
-    jaffarCommon::deserializer::Contiguous d(stateFileData.data());
-    e.deserializeState(d);
+    e.initializeVideoOutput();
+    e.enableRendering();
   }
-  
-  // Disabling requested blocks from state serialization
-  for (const auto& block : stateDisabledBlocks) e.disableStateBlock(block);
 
   // Getting full state size
   const auto stateSize = e.getStateSize();
@@ -164,6 +246,11 @@ int main(int argc, char *argv[])
   printf("[]   + Fixed Diff State Size:              %lu\n", fixedDiferentialStateSize);
   printf("[]   + Full Diff State Size:               %lu\n", fullDifferentialStateSize);
   }
+  if (threadCount > 1)
+  {
+  printf("[] Scaling Threads:                        %d\n", threadCount);
+  printf("[]   + Thread Sequence:                    '%s'\n", threadSequence.c_str());
+  }
   
   // If warmup is enabled, run it now. This helps in reducing variation in performance results due to CPU throttling
   if (useWarmUp)
@@ -180,71 +267,123 @@ int main(int argc, char *argv[])
 
   fflush(stdout);
 
-  // Serializing initial state
-  auto currentState = (uint8_t *)malloc(stateSize);
-  {
-    jaffarCommon::serializer::Contiguous cs(currentState);
-    e.serializeState(cs);
-  }
-
-  // Serializing differential state data (in case it's used)
-  uint8_t *differentialStateData = nullptr;
-  size_t differentialStateMaxSizeDetected = 0;
-
-  // Allocating memory for differential data and performing the first serialization
-  if (differentialCompressionEnabled == true) 
-  {
-    differentialStateData = (uint8_t *)malloc(fullDifferentialStateSize);
-    auto s = jaffarCommon::serializer::Differential(differentialStateData, fullDifferentialStateSize, currentState, stateSize, differentialCompressionUseZlib);
-    e.serializeState(s);
-    differentialStateMaxSizeDetected = s.getOutputSize();
-  }
-
   // Check whether to perform each action
   bool doPreAdvance = cycleType == "Rerecord";
   bool doDeserialize = cycleType == "Rerecord";
   bool doSerialize = cycleType == "Rerecord";
 
-  // Actually running the sequence
-  auto t0 = std::chrono::high_resolution_clock::now();
-  for (const auto &input : decodedSequence)
+  // State buffers of a test run: the current state and its differential encoding (in case it's used)
+  struct stateBuffers_t
   {
-    if (doPreAdvance == true) e.advanceState(input);
-    
-    if (doDeserialize == true)
+    uint8_t *currentState = nullptr;
+    uint8_t *differentialStateData = nullptr;
+    size_t differentialStateMaxSizeDetected = 0;
+  };
+
+  // Allocates the state buffers of an instance and serializes its initial state into them
+  auto serializeInitialState = [&](rawspace::EmuInstance &e)
+  {
+    stateBuffers_t b;
+
+    // Serializing initial state
+    b.currentState = (uint8_t *)malloc(stateSize);
     {
-      if (differentialCompressionEnabled == true) 
-      {
-       jaffarCommon::deserializer::Differential d(differentialStateData, fullDifferentialStateSize, currentState, stateSize, differentialCompressionUseZlib);
-       e.deserializeState(d);
-      }
+      jaffarCommon::serializer::Contiguous cs(b.currentState);
+      e.serializeState(cs);
+    }
 
-      if (differentialCompressionEnabled == false)
+    // Allocating memory for differential data and performing the first serialization
+    if (differentialCompressionEnabled == true)
+    {
+      b.differentialStateData = (uint8_t *)malloc(fullDifferentialStateSize);
+      auto s = jaffarCommon::serializer::Differential(b.differentialStateData, fullDifferentialStateSize, b.currentState, stateSize, differentialCompressionUseZlib);
+      e.serializeState(s);
+      b.differentialStateMaxSizeDetected = s.getOutputSize();
+    }
+
+    return b;
+  };
+
+  // Folds the observations (indexed and RGBA) of the current frame into a hash
+  const size_t observationPixels = rawspace::EmuInstanceBase::OBSERVATION_WIDTH * rawspace::EmuInstanceBase::OBSERVATION_HEIGHT;
+  std::vector<uint8_t> observationIndices(observationPixels);
+  std::vector<uint32_t> observationRGBA(observationPixels);
+  auto hashObservation = [&](const rawspace::EmuInstance &e, MetroHash128 &hash)
+  {
+    e.getObservationIndexed(observationIndices.data());
+    e.getObservation(observationRGBA.data());
+    hash.Update(observationIndices.data(), observationPixels);
+    hash.Update((const uint8_t *)observationRGBA.data(), observationPixels * sizeof(uint32_t));
+  };
+
+  // Runs a sequence on an instance, performing the requested cycle for each input. Frame observations are
+  // hashed into observationHash, unless null
+  auto runSequence = [&](rawspace::EmuInstance &e, const std::vector<jaffar::input_t> &sequence, stateBuffers_t &b, MetroHash128 *observationHash)
+  {
+    auto &currentState = b.currentState;
+    auto &differentialStateData = b.differentialStateData;
+    auto &differentialStateMaxSizeDetected = b.differentialStateMaxSizeDetected;
+    for (const auto &input : sequence)
+    {
+      if (doPreAdvance == true) e.advanceState(input);
+    
+      if (doDeserialize == true)
       {
-        jaffarCommon::deserializer::Contiguous d(currentState, stateSize);
-        e.deserializeState(d);
+        if (differentialCompressionEnabled == true) 
+        {
+         jaffarCommon::deserializer::Differential d(differentialStateData, fullDifferentialStateSize, currentState, stateSize, differentialCompressionUseZlib);
+         e.deserializeState(d);
+        }
+
+        if (differentialCompressionEnabled == false)
+        {
+          jaffarCommon::deserializer::Contiguous d(currentState, stateSize);
+          e.deserializeState(d);
+        } 
       } 
-    } 
     
-    e.advanceState(input);
+      e.advanceState(input);
 
-    if (doSerialize == true)
-    {
-      if (differentialCompressionEnabled == true)
-      {
-        auto s = jaffarCommon::serializer::Differential(differentialStateData, fullDifferentialStateSize, currentState, stateSize, differentialCompressionUseZlib);
-        e.serializeState(s);
-        differentialStateMaxSizeDetected = std::max(differentialStateMaxSizeDetected, s.getOutputSize());
-      }  
+      if (observationHash != nullptr) hashObservation(e, *observationHash);
 
-      if (differentialCompressionEnabled == false) 
+      if (doSerialize == true)
       {
-        auto s = jaffarCommon::serializer::Contiguous(currentState, stateSize);
-        e.serializeState(s);
-      }
-    } 
-  }
+        if (differentialCompressionEnabled == true)
+        {
+          auto s = jaffarCommon::serializer::Differential(differentialStateData, fullDifferentialStateSize, currentState, stateSize, differentialCompressionUseZlib);
+          e.serializeState(s);
+          differentialStateMaxSizeDetected = std::max(differentialStateMaxSizeDetected, s.getOutputSize());
+        }  
+
+        if (differentialCompressionEnabled == false) 
+        {
+          auto s = jaffarCommon::serializer::Contiguous(currentState, stateSize);
+          e.serializeState(s);
+        }
+      } 
+    }
+  };
+
+  // Serializing initial state
+  auto stateBuffers = serializeInitialState(e);
+
+  // If requested, migrate to the NUMA node where the test will run
+  if (runNumaNode >= 0) if (rawspace::affinity::pinThreadToNumaNode(runNumaNode) == false) JAFFAR_THROW_RUNTIME("Could not pin thread to NUMA node %d\n", runNumaNode);
+
+  // Only counting resource I/O from the test run itself
+  e.resetResourceCounters();
+
+  // Opening hardware performance counters for this thread, if requested
+  std::unique_ptr<rawspace::perf::Counters> perfCounters;
+  if (usePerfCounters == true) perfCounters = std::make_unique<rawspace::perf::Counters>();
+
+  // Actually running the sequence
+  if (usePerfCounters == true) perfCounters->start();
+  auto t0 = std::chrono::high_resolution_clock::now();
+  MetroHash128 observationHash;
+  runSequence(e, decodedSequence, stateBuffers, hashObservations ? &observationHash : nullptr);
   auto tf = std::chrono::high_resolution_clock::now();
+  if (usePerfCounters == true) perfCounters->stop();
 
   // Calculating running time
   auto dt = std::chrono::duration_cast<std::chrono::nanoseconds>(tf - t0).count();
@@ -263,10 +402,135 @@ int main(int argc, char *argv[])
   printf("[] Final State Hash:                       %s\n", hashStringBuffer);
   if (differentialCompressionEnabled == true)
   {
-  printf("[] Differential State Max Size Detected:   %lu\n", differentialStateMaxSizeDetected);    
+  printf("[] Differential State Max Size Detected:   %lu\n", stateBuffers.differentialStateMaxSizeDetected);    
+  }
+  char observationHashStringBuffer[256];
+  if (hashObservations == true)
+  {
+  jaffarCommon::hash::hash_t observationResult;
+  observationHash.Finalize(reinterpret_cast<uint8_t *>(&observationResult));
+  sprintf(observationHashStringBuffer, "0x%lX%lX", observationResult.first, observationResult.second);
+  printf("[] Observation Hash:                       %s\n", observationHashStringBuffer);
+  }
+  if (cpuHint >= 0 || numaNodeHint >= 0 || runNumaNode >= 0)
+  {
+  const auto memoryNode = e.getMemoryNumaNode();
+  const auto currentNode = rawspace::affinity::getCurrentNumaNode();
+  printf("[] NUMA Placement:                         memory on node %d, running on node %d (%s)\n", memoryNode, currentNode, memoryNode == currentNode ? "local" : "cross-node");
+  }
+  if (printResourceCounters == true)
+  {
+  printf("[] Resource Counters:\n");
+  for (const auto &counter : e.getResourceCounters()) printf("[]   + %-36s%lu\n", (counter.first + ":").c_str(), counter.second);
+  }
+  if (usePerfCounters == true)
+  {
+  if (perfCounters->isAvailable() == false)
+  printf("[] Performance Counters:                   unavailable (no hardware counters, or not allowed by /proc/sys/kernel/perf_event_paranoid)\n");
+  else
+  {
+  printf("[] Performance Counters (per input):\n");
+  for (const auto &counter : perfCounters->getCounters())
+  {
+  if (counter.fd >= 0) printf("[]   + %-36s%.3f\n", (counter.name + ":").c_str(), counter.value / (double)sequenceLength);
+  else printf("[]   + %-36sunavailable\n", (counter.name + ":").c_str());
+  }
+  double cycles, instructions;
+  if (perfCounters->getValue("Cycles", cycles) && perfCounters->getValue("Instructions", instructions) && cycles > 0.0)
+  printf("[]   + %-36s%.3f\n", "IPC:", instructions / cycles);
+  }
   }
   // If saving hash, do it now
   if (hashOutputFile != "") jaffarCommon::file::saveStringToFile(std::string(hashStringBuffer), hashOutputFile.c_str());
+  if (hashObservations == true) jaffarCommon::file::saveStringToFile(std::string(observationHashStringBuffer), observationHashOutputFile.c_str());
+
+  // Scaling run: independent instances, one per thread, all replaying at once. The test above is the single thread reference
+  if (threadCount > 1)
+  {
+    printf("[] ********** Running Scaling Test **********\n");
+    fflush(stdout);
+
+    // Results of each thread, padded to their own cache lines so that reporting does not share them
+    struct alignas(64) threadResult_t
+    {
+      std::chrono::high_resolution_clock::time_point t0;
+      std::chrono::high_resolution_clock::time_point tf;
+      jaffarCommon::hash::hash_t hash;
+      int cpu = -1;
+      std::exception_ptr error;
+    };
+    std::vector<threadResult_t> threadResults(threadCount);
+
+    // Threads only start the timed run once all of them have prepared their instance
+    std::atomic<int> readyThreads(0);
+
+    std::vector<std::thread> threads;
+    for (int threadId = 0; threadId < threadCount; threadId++) threads.push_back(std::thread([&, threadId]()
+    {
+      auto &r = threadResults[threadId];
+      bool isReady = false;
+      try
+      {
+        // Building this thread's sequence
+        auto threadDecodedSequence = decodedSequence;
+        if (threadSequence == "Offset") std::rotate(threadDecodedSequence.begin(), threadDecodedSequence.begin() + (threadId * sequenceLength) / threadCount, threadDecodedSequence.end());
+        if (threadSequence == "Shuffle") std::shuffle(threadDecodedSequence.begin(), threadDecodedSequence.end(), std::mt19937(threadId));
+
+        // Creating this thread's instance. With a cpu hint, threads are pinned to consecutive cpus
+        rawspace::EmuInstance threadInstance(configJs);
+        prepareInstance(threadInstance, cpuHint >= 0 ? cpuHint + threadId : -1);
+        auto threadStateBuffers = serializeInitialState(threadInstance);
+        if (runNumaNode >= 0) if (rawspace::affinity::pinThreadToNumaNode(runNumaNode) == false) JAFFAR_THROW_RUNTIME("Could not pin thread to NUMA node %d\n", runNumaNode);
+
+        readyThreads++;
+        isReady = true;
+        while (readyThreads.load() < threadCount) std::this_thread::yield();
+
+        r.t0 = std::chrono::high_resolution_clock::now();
+        runSequence(threadInstance, threadDecodedSequence, threadStateBuffers, nullptr);
+        r.tf = std::chrono::high_resolution_clock::now();
+
+        r.hash = threadInstance.getStateHash();
+        r.cpu = rawspace::affinity::getCurrentCpu();
+        free(threadStateBuffers.currentState);
+        free(threadStateBuffers.differentialStateData);
+      }
+      catch (...)
+      {
+        // Not holding the other threads back
+        r.error = std::current_exception();
+        if (isReady == false) readyThreads++;
+      }
+    }));
+
+    for (auto &thread : threads) thread.join();
+    for (const auto &r : threadResults) if (r.error) std::rethrow_exception(r.error);
+
+    // The aggregate throughput is taken over the wall time from the first start to the last finish
+    auto scalingT0 = threadResults[0].t0;
+    auto scalingTf = threadResults[0].tf;
+    for (const auto &r : threadResults) { scalingT0 = std::min(scalingT0, r.t0); scalingTf = std::max(scalingTf, r.tf); }
+    const double scalingTimeSeconds = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(scalingTf - scalingT0).count() * 1.0e-9;
+
+    const double singleThreadPerformance = (double)sequenceLength / elapsedTimeSeconds;
+    const double aggregatePerformance = (double)sequenceLength * threadCount / scalingTimeSeconds;
+
+    for (int threadId = 0; threadId < threadCount; threadId++)
+    {
+      const auto &r = threadResults[threadId];
+      const double threadTimeSeconds = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(r.tf - r.t0).count() * 1.0e-9;
+      printf("[]   + Thread %-3d (cpu %3d):              %.3f inputs / s - Hash: 0x%lX%lX\n", threadId, r.cpu, (double)sequenceLength / threadTimeSeconds, r.hash.first, r.hash.second);
+    }
+    printf("[] Scaling Elapsed time:                   %3.3fs\n", scalingTimeSeconds);
+    printf("[] Aggregate Performance:                  %.3f inputs / s\n", aggregatePerformance);
+    printf("[] Parallel Speedup:                       %.3fx\n", aggregatePerformance / singleThreadPerformance);
+    printf("[] Parallel Efficiency:                    %.1f%%\n", 100.0 * aggregatePerformance / (singleThreadPerformance * threadCount));
+
+    // Replaying the same sequence, every instance must end where the single thread test did
+    if (threadSequence == "Same")
+      for (int threadId = 0; threadId < threadCount; threadId++)
+        if (threadResults[threadId].hash != result) JAFFAR_THROW_RUNTIME("Thread %d final state hash differs from the single thread test\n", threadId);
+  }
 
   // If reached this point, everything ran ok
   return 0;
@@ -0,0 +1,81 @@
+#include "argparse/argparse.hpp"
+#include <jaffarCommon/exceptions.hpp>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <resource.h>
+#include <bank.h>
+
+// Microbenchmark: unpacks every bank entry of the game data, many times over.
+// The output hash lets the unpacker of both cores be compared.
+
+int main(int argc, char *argv[])
+{
+  // Parsing command line arguments
+  argparse::ArgumentParser program("unpackBench", "1.0");
+
+  program.add_argument("gameDataPath")
+    .help("Path to the game data directory (memlist.bin and bank files).")
+    .required();
+
+  program.add_argument("--iterations")
+    .help("Number of times every bank entry is unpacked.")
+    .default_value(100)
+    .scan<'i', int>();
+
+  // Try to parse arguments
+  try { program.parse_args(argc, argv); } catch (const std::runtime_error &err) { JAFFAR_THROW_LOGIC("%s\n%s", err.what(), program.help().str().c_str()); }
+
+  const auto gameDataPath = program.get<std::string>("gameDataPath");
+  const auto iterations = program.get<int>("--iterations");
+
+  // Reading the resource directory
+  Resource res(nullptr, gameDataPath.c_str());
+  res.readEntries();
+
+  // Gathering all packed entries. Buffers are large enough for the cores that unpack in place
+  std::vector<const MemEntry *> entries;
+  std::vector<std::vector<uint8_t>> buffers;
+  size_t packedBytes = 0;
+  size_t unpackedBytes = 0;
+  for (uint16_t i = 0; i < res._numMemList; i++)
+  {
+    const MemEntry *me = &res._memList[i];
+    if (me->bankId == 0 || me->packedSize == me->size) continue;
+    entries.push_back(me);
+    buffers.push_back(std::vector<uint8_t>(std::max(me->size, me->packedSize)));
+    packedBytes += me->packedSize;
+    unpackedBytes += me->size;
+  }
+
+  printf("[] -----------------------------------------\n");
+  printf("[] Game Data Path:                         '%s'\n", gameDataPath.c_str());
+  printf("[] Packed Entries:                         %lu\n", entries.size());
+  printf("[] Packed Size:                            %lu bytes\n", packedBytes);
+  printf("[] Unpacked Size:                          %lu bytes\n", unpackedBytes);
+  printf("[] Iterations:                             %d\n", iterations);
+  printf("[] ********** Running Benchmark **********\n");
+
+  Bank bk(gameDataPath.c_str());
+
+  auto t0 = std::chrono::high_resolution_clock::now();
+
+  for (int it = 0; it < iterations; it++)
+    for (size_t i = 0; i < entries.size(); i++)
+      if (bk.read(entries[i], buffers[i].data()) == false) JAFFAR_THROW_RUNTIME("Could not unpack entry %ld\n", entries[i] - res._memList);
+
+  auto tf = std::chrono::high_resolution_clock::now();
+
+  auto dt = std::chrono::duration_cast<std::chrono::nanoseconds>(tf - t0).count();
+  double elapsedTimeSeconds = (double)dt * 1.0e-9;
+
+  // Hashing the unpacked data (FNV-1a)
+  uint64_t hash = 0xCBF29CE484222325ULL;
+  for (size_t i = 0; i < entries.size(); i++)
+    for (size_t j = 0; j < entries[i]->size; j++) hash = (hash ^ buffers[i][j]) * 0x100000001B3ULL;
+
+  printf("[] Elapsed time:                           %3.3fs\n", elapsedTimeSeconds);
+  printf("[] Performance:                            %.3f MB/s unpacked, %.3f entries / s\n", (double)unpackedBytes * iterations / elapsedTimeSeconds / 1.0e6, (double)entries.size() * iterations / elapsedTimeSeconds);
+  printf("[] Unpacked Data Hash:                     0x%lX\n", hash);
+}
@@ -0,0 +1,101 @@
+#include <planar.h>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+// Checks the planar to chunky conversions of the quicker core (copyPage bitmaps) against the scalar
+// reference, in both page layouts: two pixels per byte and one (VIDEO_8BPP), over random and edge
+// case bitmaps (all zeros, all ones, single bits)
+
+static const size_t BITMAP_SIZE = PLANAR_PLANE_SIZE * 4;
+static const size_t PIXEL_COUNT = PLANAR_PLANE_SIZE * 8;
+
+// Converts a whole bitmap with 'convert', which takes 'step' bytes of each plane at a time
+template <bool UNPACKED, typename F>
+static std::vector<uint8_t> convertBitmap(const std::vector<uint8_t> &bitmap, const size_t step, F convert)
+{
+  const size_t pixelsPerByte = UNPACKED ? 1 : 2;
+  std::vector<uint8_t> page(PIXEL_COUNT / pixelsPerByte);
+  for (size_t i = 0; i < PLANAR_PLANE_SIZE; i += step) convert(&bitmap[i], &page[i * 8 / pixelsPerByte]);
+  return page;
+}
+
+// Returns the number of bitmaps where a conversion differs from the reference
+template <bool UNPACKED>
+static size_t checkLayout(const std::vector<std::pair<std::string, std::vector<uint8_t>>> &bitmaps)
+{
+  size_t failures = 0;
+  for (const auto &bitmap : bitmaps)
+  {
+    const auto reference = convertBitmap<UNPACKED>(bitmap.second, 1, planarToChunkyScalar<UNPACKED>);
+
+    std::vector<std::pair<std::string, std::vector<uint8_t>>> results;
+    results.push_back({ "SWAR", convertBitmap<UNPACKED>(bitmap.second, 1, planarToChunky<UNPACKED>) });
+#if defined(__SSE2__)
+    results.push_back({ "SSE2", convertBitmap<UNPACKED>(bitmap.second, 16, planarToChunky16<UNPACKED>) });
+#endif
+
+    for (const auto &result : results)
+      if (result.second != reference)
+      {
+        printf("[] Mismatch: %s conversion of bitmap '%s' (%s pages)\n", result.first.c_str(), bitmap.first.c_str(), UNPACKED ? "8bpp" : "packed");
+        failures++;
+      }
+  }
+  return failures;
+}
+
+int main(int argc, char *argv[])
+{
+  std::vector<std::pair<std::string, std::vector<uint8_t>>> bitmaps;
+
+  bitmaps.push_back({ "zeros", std::vector<uint8_t>(BITMAP_SIZE, 0x00) });
+  bitmaps.push_back({ "ones", std::vector<uint8_t>(BITMAP_SIZE, 0xFF) });
+
+  // The same bit of one plane, set in every byte
+  for (size_t plane = 0; plane < 4; plane++)
+    for (size_t bit = 0; bit < 8; bit++)
+    {
+      std::vector<uint8_t> bitmap(BITMAP_SIZE, 0x00);
+      memset(&bitmap[plane * PLANAR_PLANE_SIZE], 1 << bit, PLANAR_PLANE_SIZE);
+      bitmaps.push_back({ "plane " + std::to_string(plane) + " bit " + std::to_string(bit), bitmap });
+    }
+
+  // A single bit, at the edges of the bitmap and of the 16 byte blocks
+  for (const size_t offset : { (size_t)0, (size_t)15, (size_t)16, (size_t)PLANAR_PLANE_SIZE - 1 })
+    for (size_t plane = 0; plane < 4; plane++)
+      for (size_t bit = 0; bit < 8; bit++)
+      {
+        std::vector<uint8_t> bitmap(BITMAP_SIZE, 0x00);
+        bitmap[plane * PLANAR_PLANE_SIZE + offset] = 1 << bit;
+        bitmaps.push_back({ "single bit " + std::to_string(plane) + "/" + std::to_string(offset) + "/" + std::to_string(bit), bitmap });
+      }
+
+  // Random bitmaps
+  std::mt19937 random(1234);
+  for (size_t i = 0; i < 16; i++)
+  {
+    std::vector<uint8_t> bitmap(BITMAP_SIZE);
+    for (auto &b : bitmap) b = (uint8_t)random();
+    bitmaps.push_back({ "random " + std::to_string(i), bitmap });
+  }
+
+  const size_t failures = checkLayout<false>(bitmaps) + checkLayout<true>(bitmaps);
+
+  printf("[] Bitmaps Checked:                        %lu\n", bitmaps.size());
+#if defined(__SSE2__)
+  printf("[] Conversions Checked:                    SWAR, SSE2\n");
+#else
+  printf("[] Conversions Checked:                    SWAR\n");
+#endif
+  if (failures > 0)
+  {
+    printf("[] Test Failed: %lu mismatches\n", failures);
+    return -1;
+  }
+
+  printf("[] Test Passed\n");
+  return 0;
+}
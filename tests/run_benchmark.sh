@@ -0,0 +1,51 @@
+#!/bin/bash
+
+# Stop if anything fails
+set -e
+
+# Getting executable paths
+baseExecutable=${1}
+newExecutable=${2}
+
+# Getting script name
+script=${3}
+
+# Getting additional arguments
+benchmarkArgs=${@:4}
+
+# Getting current folder (game name)
+folder=`basename $PWD`
+
+# Getting pid (for uniqueness)
+pid=$$
+
+# Result files
+baseResultFile="/tmp/baseNEORAW.${folder}.${script}.${pid}.json"
+newResultFile="/tmp/newNEORAW.${folder}.${script}.${pid}.json"
+
+# Removing them if already present
+rm -f ${baseResultFile}
+rm -f ${newResultFile}
+
+set -x
+# Running benchmarks on the base core
+${baseExecutable} ${script} ${benchmarkArgs} --output ${baseResultFile}
+
+# Running benchmarks on the new core, comparing against the base results
+${newExecutable} ${script} ${benchmarkArgs} --output ${newResultFile} --compare ${baseResultFile}
+set +x
+
+# Both cores must have replayed the sequence to the same state
+baseHash=`grep '"Final State Hash"' ${baseResultFile}`
+newHash=`grep '"Final State Hash"' ${newResultFile}`
+
+# Removing temporary files
+rm -f ${baseResultFile} ${newResultFile}
+
+if [ "${baseHash}" = "${newHash}" ]; then
+ echo "[] Benchmark Passed"
+ exit 0
+else
+ echo "[] Benchmark Failed: final state hashes differ"
+ exit -1
+fi
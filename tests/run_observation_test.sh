@@ -0,0 +1,54 @@
+#!/bin/bash
+
+# Stop if anything fails
+set -e
+
+# Getting executable paths
+baseExecutable=${1}
+newExecutable=${2}
+
+# Getting script name
+script=${3}
+
+# Getting additional arguments
+testerArgs=${@:4}
+
+# The base core renders through SDL, it does not need a display
+export SDL_VIDEODRIVER=${SDL_VIDEODRIVER:-dummy}
+
+# Getting current folder (game name)
+folder=`basename $PWD`
+
+# Getting pid (for uniqueness)
+pid=$$
+
+# Observation hash files
+baseHashFile="/tmp/baseNEORAW.${folder}.${script}.${pid}.observation.hash"
+newHashFile="/tmp/newNEORAW.${folder}.${script}.${pid}.observation.hash"
+
+# Removing them if already present
+rm -f ${baseHashFile}
+rm -f ${newHashFile}
+
+set -x
+# Running script on the base core: its observations come from the SDL screen surface and palette
+${baseExecutable} ${script} --observationHashOutputFile ${baseHashFile} ${testerArgs} --cycleType Simple
+
+# Running script on the new core: its observations come from the video page and palette tables
+${newExecutable} ${script} --observationHashOutputFile ${newHashFile} ${testerArgs} --cycleType Simple
+set +x
+
+# Comparing hashes
+baseHash=`cat ${baseHashFile}`
+newHash=`cat ${newHashFile}`
+
+# Removing temporary files
+rm -f ${baseHashFile} ${newHashFile}
+
+if [ "${baseHash}" = "${newHash}" ]; then
+ echo "[] Test Passed"
+ exit 0
+else
+ echo "[] Test Failed: observations differ"
+ exit -1
+fi